@@ -7,7 +7,11 @@
 //
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
+// * To get a buffer that will be overwritten completely, call bget;
+//     it skips the disk read.
 // * After changing buffer data, call bwrite to write it to disk.
+// * To write several buffers of consecutive blocks, call bwritev;
+//     it moves each run with a single disk command.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
@@ -47,6 +51,8 @@ binit(void)
   bcache.head.prev = &bcache.head;
   bcache.head.next = &bcache.head;
   for(b = bcache.buf; b < bcache.buf+NBUF; b++){
+    if((b->data = (uchar*)kalloc()) == 0)
+      panic("binit");
     b->next = bcache.head.next;
     b->prev = &bcache.head;
     initsleeplock(&b->lock, "buffer");
@@ -58,7 +64,8 @@ binit(void)
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
 // In either case, return locked buffer.
-static struct buf*
+// The contents are only valid if B_VALID is set.
+struct buf*
 bget(uint dev, uint blockno)
 {
   struct buf *b;
@@ -115,6 +122,32 @@ bwrite(struct buf *b)
   iderw(b);
 }
 
+// Write the locked buffers bs[0..n-1] to disk.  Buffers holding
+// consecutive blocks of one device are chained through rnext
+// and go to the disk as one multi-sector transfer.
+void
+bwritev(struct buf **bs, int n)
+{
+  int i, j, k;
+
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bs[i]->lock))
+      panic("bwritev");
+    bs[i]->flags |= B_DIRTY;
+  }
+  for(i = 0; i < n; i = j){
+    for(j = i+1; j < n && j-i < BRUNMAX; j++){
+      if(bs[j]->dev != bs[i]->dev || bs[j]->blockno != bs[j-1]->blockno+1)
+        break;
+      bs[j-1]->rnext = bs[j];
+    }
+    bs[j-1]->rnext = 0;
+    iderw(bs[i]);
+    for(k = i; k < j; k++)
+      bs[k]->rnext = 0;
+  }
+}
+
 // Release a locked buffer.
 // Move to the head of the MRU list.
 void
@@ -7,8 +7,12 @@ struct buf {
   struct buf *prev; // LRU cache list
   struct buf *next;
   struct buf *qnext; // disk queue
-  uchar data[BSIZE];
+  struct buf *rnext; // next buf of a multi-block disk transfer
+  uchar *data;       // BSIZE bytes, a page of its own
 };
 #define B_VALID 0x2  // buffer has been read from disk
 #define B_DIRTY 0x4  // buffer needs to be written to disk
 
+// Max blocks the disk driver moves with one multi-sector command.
+#define BRUNMAX (16*512/BSIZE)
+
@@ -8,7 +8,12 @@ struct rtcdate;
 struct spinlock;
 struct sleeplock;
 struct stat;
+struct fsstat;
+struct sysstat;
+struct iovec;
+struct spawnact;
 struct superblock;
+struct vma;
 
 // Functions to handle page tables
 typedef unsigned int pte_t;  // Add this line
@@ -16,9 +21,11 @@ typedef unsigned int pde_t;  // This should already be there
 
 // bio.c
 void            binit(void);
+struct buf*     bget(uint, uint);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bwritev(struct buf**, int);
 
 // console.c
 void            consoleinit(void);
@@ -28,20 +35,29 @@ void            panic(char*) __attribute__((noreturn));
 
 // exec.c
 int             exec(char*, char**);
+int             execproc(struct proc*, char*, char**);
 
 // file.c
 struct file*    filealloc(void);
 void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
+int             filepread(struct file*, char*, int n, uint off);
+int             filepwrite(struct file*, char*, int n, uint off);
 int             fileread(struct file*, char*, int n);
+int             filereadv(struct file*, struct iovec*, int n);
+int             filesendfile(struct file*, struct file*, uint*, int n);
+int             fileseek(struct file*, int, int);
 int             filestat(struct file*, struct stat*);
 int             filewrite(struct file*, char*, int n);
+int             filewritev(struct file*, struct iovec*, int n);
 
 // fs.c
+extern struct fsstat fsstats;
 void            readsb(int dev, struct superblock *sb);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+void            dirunlink(struct inode*, char*, uint);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit(int dev);
@@ -53,9 +69,13 @@ void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
+struct inode*   nameinofollow(char*);
 int             readi(struct inode*, char*, uint, uint);
+int             readiput(struct inode*, uint, uint, int (*)(void*, char*, int), void*);
+void            reclaiminit(int dev);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
+int             writelink(struct inode*, char*);
 
 // ide.c
 void            ideinit(void);
@@ -102,7 +122,12 @@ void            picinit(void);
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
+int             pipeput(struct pipe*, char*, int);
 int             piperead(struct pipe*, char*, int);
+int             pipereadv(struct pipe*, struct iovec*, int);
+int             pipewait(struct pipe*);
+int             piperesize(struct pipe*, int);
+int             pipesize(struct pipe*);
 int             pipewrite(struct pipe*, char*, int);
 
 //PAGEBREAK: 16
@@ -112,6 +137,7 @@ void            exit(void);
 int             fork(void);
 int             growproc(int);
 int             kill(int);
+void            kthread(char*, void(*)(void));
 struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
@@ -120,6 +146,7 @@ void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
+int             spawn(char*, char**, struct spawnact*, int);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
@@ -153,6 +180,7 @@ int             strncmp(const char*, const char*, uint);
 char*           strncpy(char*, const char*, int);
 
 // syscall.c
+extern struct sysstat sysstats;
 int             argint(int, int*);
 int             argptr(int, char**, int);
 int             argstr(int, char**);
@@ -166,6 +194,7 @@ void            timerinit(void);
 // trap.c
 void            idtinit(void);
 extern uint     ticks;
+int             uvmfault(struct proc*, uint);
 void            tvinit(void);
 extern struct spinlock tickslock;
 
@@ -191,6 +220,16 @@ int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
 pte_t*          walkpgdir(pde_t *pgdir, const void *va, int alloc);
 int             mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm);
+struct vma*     vmalookup(struct proc*, uint);
+int             vmafault(struct proc*, struct vma*, uint);
+int             vmatouch(struct proc*, uint, uint);
+int             vmamap(struct proc*, uint, int, int, struct file*, uint);
+int             vmaunmap(struct proc*, uint, uint);
+int             vmaoverlap(struct proc*, uint, uint);
+int             vmacopy(struct proc*, struct proc*);
+void            vmaclear(struct proc*);
+int             execfault(struct proc*, uint);
+int             uvmtouch(struct proc*, uint, uint);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
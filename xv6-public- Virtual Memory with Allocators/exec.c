@@ -7,8 +7,16 @@
 #include "x86.h"
 #include "elf.h"
 
+// Set up the program at path, with arguments argv, in a new page
+// table for p and set p's registers to start it. Only the stack is
+// allocated here: the program's segments are recorded in p->seg,
+// and execfault() reads each page of them from the file when it is
+// first touched, so a large program costs only what it uses. p is the current
+// process for exec(), whose old image is freed, or a new process
+// not yet running for spawn(). argv's strings may be in the current
+// process's memory.
 int
-exec(char *path, char **argv)
+execproc(struct proc *p, char *path, char **argv)
 {
   char *s, *last;
   int i, off;
@@ -16,8 +24,10 @@ exec(char *path, char **argv)
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
+  struct inode *exe, *oldexe;
+  struct execseg seg[NSEG];
+  int nseg;
   pde_t *pgdir, *oldpgdir;
-  struct proc *curproc = myproc();
 
   begin_op();
 
@@ -28,6 +38,7 @@ exec(char *path, char **argv)
   }
   ilock(ip);
   pgdir = 0;
+  exe = 0;
 
   // Check ELF header
   if(readi(ip, (char*)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -38,8 +49,9 @@ exec(char *path, char **argv)
   if((pgdir = setupkvm()) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Record the program's segments.
   sz = 0;
+  nseg = 0;
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -47,16 +59,21 @@ exec(char *path, char **argv)
       continue;
     if(ph.memsz < ph.filesz)
       goto bad;
-    if(ph.vaddr + ph.memsz < ph.vaddr)
-      goto bad;
-    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+    if(ph.vaddr + ph.memsz < ph.vaddr || ph.vaddr + ph.memsz >= KERNBASE)
       goto bad;
-    if(ph.vaddr % PGSIZE != 0)
+    if(ph.vaddr % PGSIZE != 0 || ph.off + ph.filesz < ph.off)
       goto bad;
-    if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(nseg == NSEG || ph.vaddr < sz)
       goto bad;
+    seg[nseg].va = ph.vaddr;
+    seg[nseg].filesz = ph.filesz;
+    seg[nseg].memsz = ph.memsz;
+    seg[nseg].off = ph.off;
+    nseg++;
+    sz = ph.vaddr + ph.memsz;
   }
-  iunlockput(ip);
+  exe = ip;  // keep the reference for execfault()
+  iunlock(ip);
   end_op();
   ip = 0;
 
@@ -91,16 +108,29 @@ exec(char *path, char **argv)
   for(last=s=path; *s; s++)
     if(*s == '/')
       last = s+1;
-  safestrcpy(curproc->name, last, sizeof(curproc->name));
+  safestrcpy(p->name, last, sizeof(p->name));
 
   // Commit to the user image.
-  oldpgdir = curproc->pgdir;
-  curproc->pgdir = pgdir;
-  curproc->sz = sz;
-  curproc->tf->eip = elf.entry;  // main
-  curproc->tf->esp = sp;
-  switchuvm(curproc);
-  freevm(oldpgdir);
+  oldpgdir = p->pgdir;
+  if(oldpgdir)
+    vmaclear(p);
+  oldexe = p->exe;
+  p->exe = exe;
+  memmove(p->seg, seg, sizeof(seg));
+  p->nseg = nseg;
+  p->pgdir = pgdir;
+  p->sz = sz;
+  p->tf->eip = elf.entry;  // main
+  p->tf->esp = sp;
+  if(p == myproc())
+    switchuvm(p);
+  if(oldpgdir)
+    freevm(oldpgdir);
+  if(oldexe){
+    begin_op();
+    iput(oldexe);
+    end_op();
+  }
   return 0;
 
  bad:
@@ -110,5 +140,16 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(exe){
+    begin_op();
+    iput(exe);
+    end_op();
+  }
   return -1;
 }
+
+int
+exec(char *path, char **argv)
+{
+  return execproc(myproc(), path, argv);
+}
@@ -0,0 +1,88 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define BLOCKSIZE 512
+#define NBLOCKS 2048
+#define RUN 64
+
+char buf[BLOCKSIZE];
+
+void
+fill(int seed, int b)
+{
+  int i;
+
+  for(i = 0; i < BLOCKSIZE; i++)
+    buf[i] = seed + b + i;
+}
+
+int
+check(int seed, int b)
+{
+  int i;
+
+  for(i = 0; i < BLOCKSIZE; i++)
+    if(buf[i] != (char)(seed + b + i))
+      return -1;
+  return 0;
+}
+
+// Write two extent files in interleaved runs of RUN blocks, so that
+// neither is contiguous and both spill from the inode into an
+// extent block. Then read both back and unlink them.
+int
+main(void)
+{
+  char *name[2] = { "extent0", "extent1" };
+  int fd[2];
+  int i, b, r;
+  struct stat st;
+
+  for(i = 0; i < 2; i++){
+    fd[i] = open(name[i], O_CREATE | O_RDWR | O_EXTENT);
+    if(fd[i] < 0){
+      printf(1, "extenttest: cannot create %s\n", name[i]);
+      exit();
+    }
+  }
+
+  printf(1, "Writing %d blocks to each file...\n", NBLOCKS);
+  for(r = 0; r < NBLOCKS; r += RUN){
+    for(i = 0; i < 2; i++){
+      for(b = r; b < r + RUN; b++){
+        fill(i, b);
+        if(write(fd[i], buf, BLOCKSIZE) != BLOCKSIZE){
+          printf(1, "extenttest: write %s block %d failed\n", name[i], b);
+          exit();
+        }
+      }
+    }
+  }
+  for(i = 0; i < 2; i++)
+    close(fd[i]);
+
+  printf(1, "Reading back...\n");
+  for(i = 0; i < 2; i++){
+    fd[i] = open(name[i], O_RDONLY);
+    if(fstat(fd[i], &st) < 0 || st.size != NBLOCKS * BLOCKSIZE){
+      printf(1, "extenttest: %s has the wrong size\n", name[i]);
+      exit();
+    }
+    for(b = 0; b < NBLOCKS; b++){
+      if(read(fd[i], buf, BLOCKSIZE) != BLOCKSIZE || check(i, b) < 0){
+        printf(1, "extenttest: %s block %d is wrong\n", name[i], b);
+        exit();
+      }
+    }
+    close(fd[i]);
+    if(unlink(name[i]) < 0){
+      printf(1, "extenttest: unlink %s failed\n", name[i]);
+      exit();
+    }
+  }
+
+  printf(1, "extenttest ok\n");
+  exit();
+}
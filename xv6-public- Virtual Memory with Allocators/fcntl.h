@@ -5,6 +5,42 @@
 #define O_WRONLY  0x001
 #define O_RDWR    0x002
 #define O_CREATE  0x200
+#define O_EXTENT  0x400  // O_CREATE makes an extent-mapped file
 #define O_NOFOLLOW 0x800  // Make sure this doesn't conflict with other flags
 
+// lseek() whence
+#define SEEK_SET  0  // offset from the start of the file
+#define SEEK_CUR  1  // offset from the current position
+#define SEEK_END  2  // offset from the end of the file
+
+// A buffer for readv() and writev(), which take up to NIOV.
+struct iovec {
+  void *base;
+  int len;
+};
+#define NIOV 16
+
+// mmap() protection and flags.
+#define PROT_READ   0x1
+#define PROT_WRITE  0x2
+#define MAP_SHARED  0x1  // stores go back to the file
+#define MAP_PRIVATE 0x2  // stores stay in this process
+#define MAP_ANON    0x4  // zero-filled memory, not a file
+#define MAP_FAILED  ((void*)-1)
+
+// fcntl() commands.
+#define F_GETPIPE_SZ 1  // size of a pipe's buffer
+#define F_SETPIPE_SZ 2  // grow or shrink a pipe's buffer to at least arg
+
+// spawn() file actions, done in order to the new process's open
+// files, which start as a copy of the caller's. Up to NSPAWNACT.
+#define SPAWN_DUP   1  // make newfd refer to fd's file, as dup2() would
+#define SPAWN_CLOSE 2  // close fd
+struct spawnact {
+  int op;
+  int fd;
+  int newfd;
+};
+#define NSPAWNACT 16
+
 #endif
\ No newline at end of file
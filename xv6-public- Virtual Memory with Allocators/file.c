@@ -12,6 +12,7 @@
 #include "mmu.h"    // For NSEGS
 #include "x86.h"    // For taskstate structure
 #include "proc.h"
+#include "fcntl.h"
 
 static int growfile(struct inode *ip, int size);
 
@@ -117,60 +118,260 @@ fileread(struct file *f, char *addr, int n)
   panic("fileread");
 }
 
+// Read from file f at offset off, without moving f->off.
+int
+filepread(struct file *f, char *addr, int n, uint off)
+{
+  int r;
+
+  if(f->readable == 0 || f->type != FD_INODE)
+    return -1;
+  ilock(f->ip);
+  r = readi(f->ip, addr, off, n);
+  iunlock(f->ip);
+  return r;
+}
+
+// Read into the niov buffers of iov in turn, stopping early at
+// the end of the file. A pipe or device waits only for the first
+// bytes, as read() does, and never for a later buffer.
+int
+filereadv(struct file *f, struct iovec *iov, int niov)
+{
+  int i, r, tot;
+
+  if(f->readable == 0)
+    return -1;
+  if(f->type == FD_PIPE)
+    return pipereadv(f->pipe, iov, niov);
+  if(f->type != FD_INODE)
+    panic("filereadv");
+  ilock(f->ip);
+  tot = 0;
+  for(i = 0; i < niov; i++){
+    if((r = readi(f->ip, iov[i].base, f->off, iov[i].len)) > 0)
+      f->off += r;
+    if(r < 0){
+      if(tot == 0)
+        tot = -1;
+      break;
+    }
+    tot += r;
+    if(r < iov[i].len || f->ip->type == T_DEV)
+      break;
+  }
+  iunlock(f->ip);
+  return tot;
+}
+
+// Write the niov buffers of iov to ip at *off, advancing *off
+// as it goes. Buffers share a transaction as long as together
+// they fit in one.
+static int
+writeinode(struct inode *ip, struct iovec *iov, int niov, uint *off)
+{
+  int r, i, n, n1, tot, done, room;
+
+  // write a few blocks at a time to avoid exceeding
+  // the maximum log transaction size, including
+  // i-node, indirect block, allocation blocks,
+  // and 2 blocks of slop for non-aligned writes.
+  // this really belongs lower down, since writei()
+  // might be writing a device like the console.
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  n = 0;
+  for(i = 0; i < niov; i++)
+    n += iov[i].len;
+  tot = 0;
+  i = 0;
+  done = 0;
+  r = 0;
+  while(tot < n){
+    begin_op();
+    ilock(ip);
+    for(room = max; room > 0 && i < niov; ){
+      n1 = iov[i].len - done;
+      if(n1 > room)
+        n1 = room;
+      if(n1 > 0){
+        if((r = writei(ip, (char*)iov[i].base + done, *off, n1)) < 0)
+          break;
+        if(r != n1)
+          panic("short filewrite");
+        *off += r;
+        tot += r;
+        done += r;
+        room -= r;
+      }
+      if(done == iov[i].len){
+        i++;
+        done = 0;
+      }
+    }
+    iunlock(ip);
+    end_op();
+
+    if(r < 0)
+      break;
+  }
+  return tot == n ? n : -1;
+}
+
 //PAGEBREAK!
 // Write to file f.
 int
 filewrite(struct file *f, char *addr, int n)
 {
-  int r;
+  struct iovec iov;
 
   if(f->writable == 0)
     return -1;
   if(f->type == FD_PIPE)
     return pipewrite(f->pipe, addr, n);
   if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
-      begin_op();
-      ilock(f->ip);
-      if ((r = writei(f->ip, addr + i, f->off, n1)) > 0)
-        f->off += r;
-      iunlock(f->ip);
-      end_op();
+    iov.base = addr;
+    iov.len = n;
+    return writeinode(f->ip, &iov, 1, &f->off);
+  }
+  panic("filewrite");
+}
 
-      if(r < 0)
+// Write the niov buffers of iov in turn.
+int
+filewritev(struct file *f, struct iovec *iov, int niov)
+{
+  int i, tot;
+
+  if(f->writable == 0)
+    return -1;
+  if(f->type == FD_INODE)
+    return writeinode(f->ip, iov, niov, &f->off);
+  if(f->type == FD_PIPE){
+    tot = 0;
+    for(i = 0; i < niov; i++){
+      if(pipewrite(f->pipe, iov[i].base, iov[i].len) < 0)
+        return -1;
+      tot += iov[i].len;
+    }
+    return tot;
+  }
+  panic("filewritev");
+}
+
+// Write to file f at offset off, without moving f->off.
+int
+filepwrite(struct file *f, char *addr, int n, uint off)
+{
+  struct iovec iov;
+
+  if(f->writable == 0 || f->type != FD_INODE)
+    return -1;
+  iov.base = addr;
+  iov.len = n;
+  return writeinode(f->ip, &iov, 1, &off);
+}
+
+static int
+putpipe(void *p, char *addr, int n)
+{
+  return pipeput(p, addr, n);
+}
+
+// Move up to n bytes of in, starting at *off, to out without a
+// trip through user space, advancing *off by the number moved.
+// A pipe is filled straight from the buffer cache; the inode lock
+// is dropped whenever the pipe is full. A file or device is
+// written a page at a time through a kernel buffer. in must be a
+// file: a device like the console has no offset to move, and an
+// end of input read from it would be lost between calls.
+int
+filesendfile(struct file *out, struct file *in, uint *off, int n)
+{
+  struct iovec iov;
+  char *page;
+  int r, tot, dev;
+
+  if(in->readable == 0 || in->type != FD_INODE || out->writable == 0 || n < 0)
+    return -1;
+  ilock(in->ip);
+  dev = in->ip->type == T_DEV;
+  iunlock(in->ip);
+  if(dev)
+    return -1;
+
+  tot = 0;
+  r = 0;
+  if(out->type == FD_PIPE){
+    while(tot < n){
+      ilock(in->ip);
+      r = readiput(in->ip, *off, n - tot, putpipe, out->pipe);
+      if(r > 0){
+        *off += r;
+        tot += r;
+      }
+      if(r < 0 || *off >= in->ip->size){
+        iunlock(in->ip);
+        break;
+      }
+      iunlock(in->ip);
+      if(tot < n && pipewait(out->pipe) < 0)
         break;
-      if(r != n1)
-        panic("short filewrite");
-      i += r;
     }
-    return i == n ? n : -1;
+    return tot > 0 || r >= 0 ? tot : -1;
   }
-  panic("filewrite");
+
+  if((page = kalloc()) == 0)
+    return -1;
+  while(tot < n){
+    ilock(in->ip);
+    r = readi(in->ip, page, *off, n - tot < PGSIZE ? n - tot : PGSIZE);
+    iunlock(in->ip);
+    if(r <= 0)
+      break;
+    iov.base = page;
+    iov.len = r;
+    if(writeinode(out->ip, &iov, 1, &out->off) != r){
+      r = -1;
+      break;
+    }
+    *off += r;
+    tot += r;
+  }
+  kfree(page);
+  return tot > 0 || r >= 0 ? tot : -1;
 }
 
+// Set f's offset to offset plus the start of the file, the
+// current offset or the end of the file, as whence says.
 int
-fileseek(struct file *f, int offset)
+fileseek(struct file *f, int offset, int whence)
 {
+  int base;
+
   if(f == 0)
     return -1;
     
   if(f->type != FD_INODE)
     return -1;
     
+  switch(whence){
+  case SEEK_SET:
+    base = 0;
+    break;
+  case SEEK_CUR:
+    base = f->off;
+    break;
+  case SEEK_END:
+    ilock(f->ip);
+    base = f->ip->size;
+    iunlock(f->ip);
+    break;
+  default:
+    return -1;
+  }
+
   // Calculate new offset
-  int new_offset = f->off + offset;
+  int new_offset = base + offset;
   
   // Don't allow negative file positions
   if(new_offset < 0)
@@ -221,7 +422,7 @@ growfile(struct inode *ip, int size)
   if(ip->type != T_FILE)
     return -1;
     
-  if(size > MAXFILE*BSIZE)
+  if(size > MAXFILESIZE)
     return -1;
     
   ip->size = size;
@@ -11,20 +11,37 @@ struct file {
 };
 
 
+// A run of an inode's blocks: file blocks bn..bn+len-1
+// are disk blocks addr..addr+len-1.
+struct bmaprun {
+  uint bn;
+  uint addr;
+  uint len;
+};
+
 // in-memory copy of an inode
 struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *hnext; // hash chain, see iget()
+  struct inode *prev;  // LRU list of unreferenced inodes
+  struct inode *next;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
   short type;         // copy of disk inode
+  short flags;
   short major;
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  uint addrs[NDIRECT+3];
+
+  struct bmaprun bmapc[NBMAPC]; // recently used runs, see bmap()
+  uint bmapnext;      // bmapc slot to replace next
+  int linklen;        // length of link[], or -1 if not read yet
+  char link[MAXPATH]; // symlink target, see readlink()
 };
 
 // table mapping major device number to
@@ -35,7 +52,6 @@ struct devsw {
 };
 
 extern struct devsw devsw[];
-int fileseek(struct file*, int);
 
 #define CONSOLE 1
 #ifndef FILE_H
@@ -23,9 +23,13 @@
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 static void itrunc(struct inode*);
+static int reclaimput(struct inode*);
+static void dcacheinit(void);
+static void dcachepurge(struct inode*);
 // there should be one superblock per disk device, but we run with
 // only one device
 struct superblock sb; 
+struct fsstat fsstats;  // counters reported by fsstat()
 
 // Read the super block.
 void
@@ -38,60 +42,130 @@ readsb(int dev, struct superblock *sb)
   brelse(bp);
 }
 
-// Zero a block.
+// Zero a block.  The old contents don't matter, so skip the read.
 static void
 bzero(int dev, int bno)
 {
   struct buf *bp;
 
-  bp = bread(dev, bno);
+  bp = bget(dev, bno);
   memset(bp->data, 0, BSIZE);
+  bp->flags |= B_VALID;
   log_write(bp);
   brelse(bp);
 }
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// Allocation hint: no block below bhint is free. Like sb there
+// is one per file system, and we run with only one. Updates are
+// not locked; a stale hint only costs a wrap-around in
+// balloc_range(), never a missed free block.
+static uint bhint;
+
+// Return the first free block at or after from in the bitmap
+// block bp, which covers blocks b..b+BPB-1, or -1 if none.
+// Skips fully allocated words and bytes without testing bits.
+static int
+bscan(struct buf *bp, uint b, uint from)
+{
+  uint bi;
+
+  for(bi = from - b; bi < BPB && b + bi < sb.size; ){
+    if(bi % 32 == 0 && ((uint*)bp->data)[bi/32] == 0xffffffff){
+      bi += 32;
+    } else if(bi % 8 == 0 && bp->data[bi/8] == 0xff){
+      bi += 8;
+    } else if((bp->data[bi/8] & (1 << (bi % 8))) == 0){
+      return b + bi;
+    } else {
+      bi++;
+    }
+  }
+  return -1;
+}
+
+// Allocate up to n contiguous zeroed disk blocks and return the
+// first; *got is set to how many (at least 1). The search starts
+// at goal if it is non-zero, else at the allocation hint, and
+// wraps around the end of the disk. A run never spans two bitmap
+// blocks, so the bitmap costs one log_write() per call.
 static uint
-balloc(uint dev)
+balloc_range(uint dev, uint goal, uint n, uint *got)
 {
-  int b, bi, m;
+  int bi, fromhint;
+  uint b, i, k, m, from, nb;
   struct buf *bp;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
+  fromhint = !(goal > 0 && goal < sb.size);
+  from = fromhint ? bhint : goal;
+  if(from >= sb.size)
+    from = 0;
+  nb = (sb.size + BPB - 1) / BPB;
+  b = from - from % BPB;
+  for(i = 0; i <= nb; i++){
     bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+    if((bi = bscan(bp, b, from)) >= 0){
+      for(k = 0; k < n && bi + k < b + BPB && bi + k < sb.size; k++){
+        m = 1 << ((bi + k - b) % 8);
+        if(bp->data[(bi + k - b)/8] & m)
+          break;
+        bp->data[(bi + k - b)/8] |= m;  // Mark block in use.
       }
+      log_write(bp);
+      brelse(bp);
+      if(fromhint)
+        bhint = bi + k;
+      for(m = 0; m < k; m++)
+        bzero(dev, bi + m);
+      *got = k;
+      return bi;
     }
     brelse(bp);
+    b += BPB;
+    if(b >= sb.size)
+      b = 0;
+    from = b;
   }
   panic("balloc: out of blocks");
 }
 
-// Free a disk block.
+// Allocate a zeroed disk block, near goal if possible.
+static uint
+balloc(uint dev, uint goal)
+{
+  uint got;
+
+  return balloc_range(dev, goal, 1, &got);
+}
+
+// Free disk blocks b..b+n-1, which must share a bitmap block,
+// with one read and log_write() of that block.
 static void
-bfree(int dev, uint b)
+bfreerun(int dev, uint b, uint n)
 {
   struct buf *bp;
-  int bi, m;
+  uint bi;
+  int m;
 
   bp = bread(dev, BBLOCK(b, sb));
-  bi = b % BPB;
-  m = 1 << (bi % 8);
-  if((bp->data[bi/8] & m) == 0)
-    panic("freeing free block");
-  bp->data[bi/8] &= ~m;
+  for(bi = b % BPB; bi < b % BPB + n; bi++){
+    m = 1 << (bi % 8);
+    if((bp->data[bi/8] & m) == 0)
+      panic("freeing free block");
+    bp->data[bi/8] &= ~m;
+  }
   log_write(bp);
   brelse(bp);
+  if(b < bhint)
+    bhint = b;
+}
+
+// Free a disk block.
+static void
+bfree(int dev, uint b)
+{
+  bfreerun(dev, b, 1);
 }
 
 // Inodes.
@@ -158,6 +232,12 @@ bfree(int dev, uint b)
 // entries. Since ip->ref indicates whether an entry is free,
 // and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold icache.lock while using any of those fields.
+// It also protects the hash chains and the LRU list.
+//
+// An entry whose ref falls to zero stays in the cache, still
+// valid, on an LRU list; iget() finds it again through the hash
+// table without reading the disk, and recycles the least
+// recently used entry when it needs a new one.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
@@ -165,24 +245,73 @@ bfree(int dev, uint b)
 
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *hash[NIHASH];
+  // Unreferenced entries, through prev/next.
+  // lru.next is least recently used.
+  struct inode lru;
+  int ninode;
+  uint freehint;  // ialloc() starts looking for a free inode here
 } icache;
 
+#define IHASH(dev, inum) (((dev) * 31 + (inum)) % NIHASH)
+
+// Add ip to the LRU list: at the recently used end, or, if its
+// contents are no use, at the end that is recycled first.
+static void
+lruput(struct inode *ip, int keep)
+{
+  struct inode *at;
+
+  at = keep ? icache.lru.prev : &icache.lru;
+  ip->prev = at;
+  ip->next = at->next;
+  at->next->prev = ip;
+  at->next = ip;
+}
+
+static void
+lrudel(struct inode *ip)
+{
+  ip->prev->next = ip->next;
+  ip->next->prev = ip->prev;
+}
+
+// Size the inode cache at one entry for every eight inodes on
+// the disk, but at least NINODE, carved from whole pages.
 void
 iinit(int dev)
 {
-  int i = 0;
-  
+  int i, per;
+  char *page;
+  struct inode *ip;
+
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
-  }
+  dcacheinit();
 
   readsb(dev, &sb);
+  if(sb.magic != FSMAGIC || sb.version != FSVERSION || sb.bsize != BSIZE)
+    panic("iinit: unknown file system format");
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
  inodestart %d bmap start %d\n", sb.size, sb.nblocks,
           sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
           sb.bmapstart);
+
+  icache.lru.prev = &icache.lru;
+  icache.lru.next = &icache.lru;
+  icache.freehint = 1;
+  per = PGSIZE / sizeof(struct inode);
+  page = 0;
+  for(i = 0; i < NINODE || i < sb.ninodes / 8; i++){
+    if(i % per == 0 && (page = kalloc()) == 0)
+      break;
+    ip = (struct inode*)page + i % per;
+    memset(ip, 0, sizeof(*ip));
+    initsleeplock(&ip->lock, "inode");
+    lruput(ip, 0);
+  }
+  if(i < NINODE)
+    panic("iinit: no memory");
+  icache.ninode = i;
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -191,23 +320,40 @@ static struct inode* iget(uint dev, uint inum);
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
 // Returns an unlocked but allocated and referenced inode.
+// The search starts at icache.freehint, below which inodes are
+// usually all in use, looks at every inode in a block with one
+// bread(), and wraps around to inode 1.
 struct inode*
 ialloc(uint dev, short type)
 {
-  int inum;
+  uint inum, start, n;
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
+  acquire(&icache.lock);
+  start = icache.freehint;
+  release(&icache.lock);
+
+  inum = start;
+  for(n = 0; n < sb.ninodes - 1; ){
     bp = bread(dev, IBLOCK(inum, sb));
-    dip = (struct dinode*)bp->data + inum%IPB;
-    if(dip->type == 0){  // a free inode
-      memset(dip, 0, sizeof(*dip));
-      dip->type = type;
-      log_write(bp);   // mark it allocated on the disk
-      brelse(bp);
-      return iget(dev, inum);
-    }
+    do {
+      dip = (struct dinode*)bp->data + inum%IPB;
+      if(dip->type == 0){  // a free inode
+        memset(dip, 0, sizeof(*dip));
+        dip->type = type;
+        log_write(bp);   // mark it allocated on the disk
+        brelse(bp);
+        acquire(&icache.lock);
+        if(icache.freehint == start)
+          icache.freehint = inum + 1 < sb.ninodes ? inum + 1 : 1;
+        release(&icache.lock);
+        return iget(dev, inum);
+      }
+      n++;
+      if(++inum == sb.ninodes)
+        inum = 1;
+    } while(inum%IPB != 0 && inum != 1 && n < sb.ninodes - 1);
     brelse(bp);
   }
   panic("ialloc: no inodes");
@@ -226,6 +372,7 @@ iupdate(struct inode *ip)
   bp = bread(ip->dev, IBLOCK(ip->inum, sb));
   dip = (struct dinode*)bp->data + ip->inum%IPB;
   dip->type = ip->type;
+  dip->flags = ip->flags;
   dip->major = ip->major;
   dip->minor = ip->minor;
   dip->nlink = ip->nlink;
@@ -241,31 +388,39 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip, **pp;
 
   acquire(&icache.lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+  for(ip = icache.hash[IHASH(dev, inum)]; ip; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref++ == 0)
+        lrudel(ip);
+      fsstats.icachehits++;
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  // Recycle the least recently used unreferenced entry.
+  if((ip = icache.lru.next) == &icache.lru)
     panic("iget: no inodes");
+  fsstats.icachemisses++;
+  lrudel(ip);
+  for(pp = &icache.hash[IHASH(ip->dev, ip->inum)]; *pp; pp = &(*pp)->hnext){
+    if(*pp == ip){
+      *pp = ip->hnext;
+      break;
+    }
+  }
 
-  ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->hnext = icache.hash[IHASH(dev, inum)];
+  icache.hash[IHASH(dev, inum)] = ip;
   release(&icache.lock);
 
   return ip;
@@ -299,12 +454,15 @@ ilock(struct inode *ip)
     bp = bread(ip->dev, IBLOCK(ip->inum, sb));
     dip = (struct dinode*)bp->data + ip->inum%IPB;
     ip->type = dip->type;
+    ip->flags = dip->flags;
     ip->major = dip->major;
     ip->minor = dip->minor;
     ip->nlink = dip->nlink;
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    memset(ip->bmapc, 0, sizeof(ip->bmapc));
+    ip->linklen = -1;
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -331,23 +489,38 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
+  int valid;
+
   acquiresleep(&ip->lock);
   if(ip->valid && ip->nlink == 0){
     acquire(&icache.lock);
     int r = ip->ref;
     release(&icache.lock);
     if(r == 1){
-      // inode has no links and no other references: truncate and free.
+      // inode has no links and no other references: truncate and free,
+      // leaving large files to the reclaim thread.
+      if(ip->size > NDIRECT*BSIZE && reclaimput(ip)){
+        releasesleep(&ip->lock);
+        return;
+      }
+      if(ip->type == T_DIR)
+        dcachepurge(ip);
       itrunc(ip);
       ip->type = 0;
       iupdate(ip);
       ip->valid = 0;
+      acquire(&icache.lock);
+      if(ip->inum < icache.freehint)
+        icache.freehint = ip->inum;
+      release(&icache.lock);
     }
   }
+  valid = ip->valid;
   releasesleep(&ip->lock);
 
   acquire(&icache.lock);
-  ip->ref--;
+  if(--ip->ref == 0)
+    lruput(ip, valid);
   release(&icache.lock);
 }
 
@@ -367,18 +540,158 @@ iunlockput(struct inode *ip)
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
 // listed in block ip->addrs[NDIRECT].
 
+// Return newaddr if it is non-zero, else a fresh block for a
+// file whose preceding block is prev, placed right after prev
+// if possible so the file stays contiguous.
+static uint
+bnew(struct inode *ip, uint prev, uint newaddr)
+{
+  if(newaddr)
+    return newaddr;
+  return balloc(ip->dev, prev ? prev + 1 : 0);
+}
+
+// Each inode caches the last few runs of contiguous blocks
+// that bmapalloc() has looked up, so that bmap() can usually
+// map a block without reading indirect or extent blocks.
+// The runs stay valid until itrunc(): files only grow at the
+// end, and a mapped block never moves.
+
+// Remember that ip's blocks bn..bn+len-1 are disk blocks
+// addr..addr+len-1, extending a cached run if this one
+// continues it.
+static void
+bmapcache(struct inode *ip, uint bn, uint addr, uint len)
+{
+  struct bmaprun *r;
+
+  for(r = ip->bmapc; r < &ip->bmapc[NBMAPC]; r++){
+    if(r->len && r->bn + r->len == bn && r->addr + r->len == addr){
+      r->len += len;
+      return;
+    }
+  }
+  r = &ip->bmapc[ip->bmapnext++ % NBMAPC];
+  r->bn = bn;
+  r->addr = addr;
+  r->len = len;
+}
+
+// Number of consecutive block numbers in a[i..n-1]
+// starting at a[i].
+static uint
+runlen(uint *a, uint i, uint n)
+{
+  uint k;
+
+  for(k = 1; i + k < n && a[i+k] == a[i] + k; k++)
+    ;
+  return k;
+}
+
+// Extents.
+//
+// An inode with I_EXTENT set maps its blocks as runs (see
+// struct extent in fs.h), so a contiguous file needs a single
+// extent and no indirect blocks at all.
+
+// Return extent i of ip. Extents past the inode's own NEXTENT
+// live in the extent block, which is read into *bpp, and
+// allocated first if alloc is set; otherwise return 0 if ip
+// has no extent block.
+static struct extent*
+eslot(struct inode *ip, uint i, struct buf **bpp, int alloc)
+{
+  if(i < NEXTENT)
+    return (struct extent*)ip->addrs + i;
+  if(*bpp == 0){
+    if(ip->addrs[NEXTENT*2] == 0){
+      if(!alloc)
+        return 0;
+      ip->addrs[NEXTENT*2] = balloc(ip->dev, 0);
+    }
+    *bpp = bread(ip->dev, ip->addrs[NEXTENT*2]);
+  }
+  return (struct extent*)(*bpp)->data + (i - NEXTENT);
+}
+
+// bmapalloc() for extent-mapped inodes. Missing blocks up to bn
+// are appended to the last extent if they follow it on disk, or
+// else start a new extent. Returns 0 if ip is out of extents.
+static uint
+emapalloc(struct inode *ip, uint bn, uint newaddr)
+{
+  struct extent *e, *last;
+  struct buf *bp;
+  uint i, lasti, base, addr;
+
+  bp = 0;
+  last = 0;
+  lasti = 0;
+  base = 0;
+  for(i = 0; i < NEXTENT + NEXTENTBLK; i++){
+    if((e = eslot(ip, i, &bp, 0)) == 0 || e->len == 0)
+      break;
+    if(bn < base + e->len){
+      addr = e->start + (bn - base);
+      bmapcache(ip, bn, addr, e->len - (bn - base));
+      if(bp)
+        brelse(bp);
+      return addr;
+    }
+    base += e->len;
+    last = e;
+    lasti = i;
+  }
+
+  // Append blocks base..bn; files have no holes.
+  for(addr = 0; base <= bn; base++){
+    if(base == bn && newaddr)
+      addr = newaddr;
+    else
+      addr = balloc(ip->dev, last ? last->start + last->len : 0);
+    if(last && last->start + last->len == addr){
+      last->len++;
+    } else if(i < NEXTENT + NEXTENTBLK && (e = eslot(ip, i, &bp, 1)) != 0){
+      e->start = addr;
+      e->len = 1;
+      last = e;
+      lasti = i++;
+    } else {
+      if(addr != newaddr)
+        bfree(ip->dev, addr);
+      addr = 0;
+      break;
+    }
+    if(lasti >= NEXTENT)
+      log_write(bp);
+  }
+  if(bp)
+    brelse(bp);
+  if(addr)
+    bmapcache(ip, bn, addr, 1);
+  return addr;
+}
+
 // Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// If there is no such block, map newaddr there, or allocate a
+// block if newaddr is 0. Returns 0 if the block can't be mapped.
+// Caches the run of blocks the lookup finds (see bmapcache()).
 static uint
-bmap(struct inode *ip, uint bn)
+bmapalloc(struct inode *ip, uint bn, uint newaddr)
 {
-  uint addr, *a;
+  uint addr, fbn, *a;
   struct buf *bp, *bp2;
 
+  if(ip->flags & I_EXTENT)
+    return emapalloc(ip, bn, newaddr);
+  fbn = bn;
+
   // Direct blocks
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = bnew(ip, bn > 0 ? ip->addrs[bn-1] : 0, newaddr);
+    bmapcache(ip, fbn, addr, runlen(ip->addrs, bn, NDIRECT));
     return addr;
   }
   bn -= NDIRECT;
@@ -386,13 +699,14 @@ bmap(struct inode *ip, uint bn)
   // Single indirect block
   if(bn < NINDIRECT){
     if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+      ip->addrs[NDIRECT] = addr = balloc(ip->dev, 0);
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+      a[bn] = addr = bnew(ip, bn > 0 ? a[bn-1] : ip->addrs[NDIRECT-1], newaddr);
       log_write(bp);
     }
+    bmapcache(ip, fbn, addr, runlen(a, bn, NINDIRECT));
     brelse(bp);
     return addr;
   }
@@ -410,7 +724,7 @@ bmap(struct inode *ip, uint bn)
 
     // Allocate double-indirect block if needed
     if((addr = ip->addrs[NDIRECT + 1 + di_index]) == 0)
-      ip->addrs[NDIRECT + 1 + di_index] = addr = balloc(ip->dev);
+      ip->addrs[NDIRECT + 1 + di_index] = addr = balloc(ip->dev, 0);
     
     // Read double-indirect block
     bp = bread(ip->dev, addr);
@@ -418,7 +732,7 @@ bmap(struct inode *ip, uint bn)
 
     // Allocate indirect block if needed
     if((addr = a[outer]) == 0){
-      a[outer] = addr = balloc(ip->dev);
+      a[outer] = addr = balloc(ip->dev, 0);
       log_write(bp);
     }
     brelse(bp);
@@ -429,9 +743,10 @@ bmap(struct inode *ip, uint bn)
     
     // Allocate data block if needed
     if((addr = a[inner]) == 0){
-      a[inner] = addr = balloc(ip->dev);
+      a[inner] = addr = bnew(ip, inner > 0 ? a[inner-1] : 0, newaddr);
       log_write(bp2);
     }
+    bmapcache(ip, fbn, addr, runlen(a, inner, NINDIRECT));
     brelse(bp2);
     return addr;
   }
@@ -439,64 +754,310 @@ bmap(struct inode *ip, uint bn)
   panic("bmap: out of range");
 }
 
-// Truncate inode (discard contents).
+// Return the disk block address of the nth block in inode ip.
+// If there is no such block, bmap allocates one.
+// Returns 0 if an extent-mapped inode is out of extents.
+static uint
+bmap(struct inode *ip, uint bn)
+{
+  struct bmaprun *r;
+
+  for(r = ip->bmapc; r < &ip->bmapc[NBMAPC]; r++){
+    if(bn - r->bn < r->len){
+      fsstats.bmaphits++;
+      return r->addr + (bn - r->bn);
+    }
+  }
+  fsstats.bmapmisses++;
+  return bmapalloc(ip, bn, 0);
+}
+
+// Allocate the blocks that growing ip to end bytes adds past its
+// current last block, in as few contiguous runs as the free map
+// allows, continuing from the file's current last block.
+static void
+iprealloc(struct inode *ip, uint end)
+{
+  uint bn, last, addr, got, goal, i;
+
+  bn = (ip->size + BSIZE - 1) / BSIZE;
+  last = (end + BSIZE - 1) / BSIZE;
+  goal = bn > 0 ? bmap(ip, bn - 1) + 1 : 0;
+  for(; bn < last; bn += got){
+    addr = balloc_range(ip->dev, goal, last - bn, &got);
+    for(i = 0; i < got; i++){
+      // A block that is already mapped keeps its old address.
+      if(bmapalloc(ip, bn + i, addr + i) != addr + i)
+        bfree(ip->dev, addr + i);
+    }
+    goal = addr + got;
+  }
+}
+
+// Truncation.
+//
+// Freeing a large file's blocks can dirty more bitmap blocks
+// than one transaction may log, so itrim() frees them from the
+// end of the file towards the start and can stop part way,
+// leaving a smaller but consistent file for the next
+// transaction to carry on with.
+
+// The blocks one itrim() call frees. Runs of contiguous blocks
+// are freed with one bitmap update each, and the bitmap blocks
+// touched are counted against a budget.
+struct trim {
+  uint dev;
+  uint start, len;        // run of blocks waiting to be freed
+  uint bb[MAXOPBLOCKS];   // bitmap blocks dirtied so far
+  int nbb;
+  int maxbb;              // budget for bb[], or 0 for no limit
+};
+
+static void
+trimflush(struct trim *t)
+{
+  if(t->len > 0)
+    bfreerun(t->dev, t->start, t->len);
+  t->len = 0;
+}
+
+// Free block b. Returns 0, freeing nothing, if that would dirty
+// one bitmap block more than t's budget allows.
+static int
+trimblock(struct trim *t, uint b)
+{
+  uint bb;
+  int i;
+
+  bb = BBLOCK(b, sb);
+  if(t->len > 0 && bb == BBLOCK(t->start, sb)){
+    if(b + 1 == t->start){
+      t->start = b;
+      t->len++;
+      return 1;
+    }
+    if(b == t->start + t->len){
+      t->len++;
+      return 1;
+    }
+  }
+  for(i = 0; i < t->nbb; i++)
+    if(t->bb[i] == bb)
+      break;
+  if(i == t->nbb){
+    if(t->maxbb && t->nbb == t->maxbb)
+      return 0;
+    if(t->nbb < NELEM(t->bb))
+      t->bb[t->nbb++] = bb;
+  }
+  trimflush(t);
+  t->start = b;
+  t->len = 1;
+  return 1;
+}
+
+// Free the blocks that indirect block addr lists, last first,
+// and then addr itself; with depth 2, each listed block is an
+// indirect block to free likewise. Returns 0 if t's budget runs
+// out first, in which case addr is kept, listing what is left.
+static int
+trimmap(struct trim *t, uint addr, int depth)
+{
+  struct buf *bp;
+  uint *a;
+  int i, dirty;
+
+  bp = bread(t->dev, addr);
+  a = (uint*)bp->data;
+  dirty = 0;
+  for(i = NINDIRECT - 1; i >= 0; i--){
+    if(a[i] == 0)
+      continue;
+    if(depth > 1 ? !trimmap(t, a[i], depth - 1) : !trimblock(t, a[i]))
+      break;
+    a[i] = 0;
+    dirty = 1;
+  }
+  if(i < 0 && trimblock(t, addr)){
+    brelse(bp);
+    return 1;
+  }
+  if(dirty)
+    log_write(bp);
+  brelse(bp);
+  return 0;
+}
+
+// Free the blocks of an extent-mapped inode, last extent first.
+static int
+trimextents(struct trim *t, struct inode *ip)
+{
+  struct extent *e;
+  struct buf *bp;
+  uint n;
+
+  bp = 0;
+  for(n = 0; n < NEXTENT + NEXTENTBLK; n++)
+    if((e = eslot(ip, n, &bp, 0)) == 0 || e->len == 0)
+      break;
+  for(; n > 0; n--){
+    e = eslot(ip, n - 1, &bp, 0);
+    while(e->len > 0 && trimblock(t, e->start + e->len - 1))
+      e->len--;
+    if(e->len > 0)
+      break;
+  }
+  if(n <= NEXTENT && ip->addrs[NEXTENT*2] && trimblock(t, ip->addrs[NEXTENT*2]))
+    ip->addrs[NEXTENT*2] = 0;
+  if(bp){
+    if(ip->addrs[NEXTENT*2])
+      log_write(bp);
+    brelse(bp);
+  }
+  return n == 0 && ip->addrs[NEXTENT*2] == 0;
+}
+
+// Discard ip's contents, or as much of them as dirties at most
+// maxbb bitmap blocks (no limit if maxbb is 0). Returns 1 once
+// ip has no blocks left. The file's size drops to 0 at once:
+// it is only called on inodes that no one can read any more.
+// Caller must hold ip->lock and be in a transaction.
+static int
+itrim(struct inode *ip, int maxbb)
+{
+  struct trim t;
+  int i, done;
+
+  memset(&t, 0, sizeof(t));
+  t.dev = ip->dev;
+  t.maxbb = maxbb;
+  if(ip->flags & I_INLINE){
+    memset(ip->addrs, 0, sizeof(ip->addrs));
+    ip->flags &= ~I_INLINE;
+    done = 1;
+  } else if(ip->flags & I_EXTENT){
+    done = trimextents(&t, ip);
+  } else {
+    for(i = NDIRECT + 2; i >= 0; i--){
+      if(ip->addrs[i] == 0)
+        continue;
+      if(i < NDIRECT ? !trimblock(&t, ip->addrs[i]) :
+         !trimmap(&t, ip->addrs[i], i == NDIRECT ? 1 : 2))
+        break;
+      ip->addrs[i] = 0;
+    }
+    done = i < 0;
+  }
+  trimflush(&t);
+  memset(ip->bmapc, 0, sizeof(ip->bmapc));
+  ip->size = 0;
+  iupdate(ip);
+  return done;
+}
+
+// Truncate inode (discard contents) in the caller's transaction.
 // Only called when the inode has no links
 // to it (no directory entries referring to it)
 // and has no in-memory reference to it (is
 // not an open file or current directory).
-void
+static void
 itrunc(struct inode *ip)
 {
-  int i, j, k;
-  struct buf *bp, *bp2;
-  uint *a, *b;
+  itrim(ip, 0);
+}
 
-  // Free direct blocks
-  for(i = 0; i < NDIRECT; i++){
-    if(ip->addrs[i]){
-      bfree(ip->dev, ip->addrs[i]);
-      ip->addrs[i] = 0;
-    }
+// Reclaim.
+//
+// iput() hands the last reference to an unlinked inode with
+// indirect blocks to the reclaim thread, which frees the
+// blocks a few bitmap blocks per transaction. unlink() of a
+// large file then returns at once, and no transaction has to
+// log the whole bitmap.
+
+struct {
+  struct spinlock lock;
+  struct inode *ip[NRECLAIM];
+  int n;
+  int running;
+} reclaimq;
+
+// Queue ip, whose last reference the caller is giving up, for
+// the reclaim thread. Returns 0 if the queue is full.
+static int
+reclaimput(struct inode *ip)
+{
+  int ok;
+
+  acquire(&reclaimq.lock);
+  ok = reclaimq.running && reclaimq.n < NRECLAIM;
+  if(ok){
+    reclaimq.ip[reclaimq.n++] = ip;
+    wakeup(&reclaimq);
   }
+  release(&reclaimq.lock);
+  return ok;
+}
 
-  // Free indirect blocks
-  if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
-    }
+// Free unlinked inode ip, one transaction per itrim() step,
+// and drop the caller's reference to it.
+static void
+ireclaim(struct inode *ip)
+{
+  int done;
+
+  do {
+    begin_op();
+    ilock(ip);
+    done = itrim(ip, MAXOPBLOCKS - 3);  // inode + two map blocks
+    iunlock(ip);
+    end_op();
+  } while(!done);
+
+  begin_op();
+  iput(ip);
+  end_op();
+}
+
+static void
+reclaim(void)
+{
+  struct inode *ip;
+
+  for(;;){
+    acquire(&reclaimq.lock);
+    while(reclaimq.n == 0)
+      sleep(&reclaimq, &reclaimq.lock);
+    ip = reclaimq.ip[--reclaimq.n];
+    release(&reclaimq.lock);
+    ireclaim(ip);
+  }
+}
+
+// Free the inodes that were unlinked but not yet freed when the
+// system stopped (still open, or part way through reclaim), and
+// then start the reclaim thread. Runs before any user process.
+void
+reclaiminit(int dev)
+{
+  int inum;
+  struct buf *bp;
+  struct dinode *dip;
+  struct inode *ip;
+
+  initlock(&reclaimq.lock, "reclaim");
+  for(inum = 1; inum < sb.ninodes; inum++){
+    bp = bread(dev, IBLOCK(inum, sb));
+    dip = (struct dinode*)bp->data + inum%IPB;
+    ip = 0;
+    if(dip->type != 0 && dip->nlink == 0)
+      ip = iget(dev, inum);
     brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
-  }
-
-  // Free double-indirect blocks
-  for(i = 0; i < 2; i++){
-    if(ip->addrs[NDIRECT + 1 + i]){
-      bp = bread(ip->dev, ip->addrs[NDIRECT + 1 + i]);
-      a = (uint*)bp->data;
-      for(j = 0; j < NINDIRECT; j++){
-        if(a[j]){
-          bp2 = bread(ip->dev, a[j]);
-          b = (uint*)bp2->data;
-          for(k = 0; k < NINDIRECT; k++){
-            if(b[k])
-              bfree(ip->dev, b[k]);
-          }
-          brelse(bp2);
-          bfree(ip->dev, a[j]);
-        }
-      }
-      brelse(bp);
-      bfree(ip->dev, ip->addrs[NDIRECT + 1 + i]);
-      ip->addrs[NDIRECT + 1 + i] = 0;
-    }
+    if(ip)
+      ireclaim(ip);
   }
 
-  ip->size = 0;
-  iupdate(ip);
+  reclaimq.running = 1;
+  kthread("reclaim", reclaim);
 }
 
 // Copy stat information from inode.
@@ -531,6 +1092,11 @@ readi(struct inode *ip, char *dst, uint off, uint n)
   if(off + n > ip->size)
     n = ip->size - off;
 
+  if(ip->flags & I_INLINE){
+    memmove(dst, (char*)ip->addrs + off, n);
+    return n;
+  }
+
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
     bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
@@ -540,13 +1106,47 @@ readi(struct inode *ip, char *dst, uint off, uint n)
   return n;
 }
 
+// Hand up to n bytes of ip from off to put(arg, data, m) a
+// block at a time, straight from the buffer cache, until put()
+// takes less than it was given. Returns the number of bytes
+// taken, or -1 if put() failed before taking any.
+// Caller must hold ip->lock.
+int
+readiput(struct inode *ip, uint off, uint n,
+         int (*put)(void*, char*, int), void *arg)
+{
+  uint tot, m;
+  int r;
+  struct buf *bp;
+
+  if(ip->type == T_DEV || (ip->flags & I_INLINE))
+    return -1;
+  if(off > ip->size || off + n < off)
+    return -1;
+  if(off + n > ip->size)
+    n = ip->size - off;
+
+  for(tot=0; tot<n; tot+=m, off+=m){
+    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    m = min(n - tot, BSIZE - off%BSIZE);
+    r = put(arg, (char*)bp->data + off%BSIZE, m);
+    brelse(bp);
+    if(r < 0)
+      return tot > 0 ? tot : -1;
+    if(r < m)
+      return tot + r;
+  }
+  return n;
+}
+
 // PAGEBREAK!
 // Write data to inode.
 // Caller must hold ip->lock.
 int
 writei(struct inode *ip, char *src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, addr;
+  int grow;
   struct buf *bp;
 
   if(ip->type == T_DEV){
@@ -555,24 +1155,79 @@ writei(struct inode *ip, char *src, uint off, uint n)
     return devsw[ip->major].write(ip, src, n);
   }
 
-  if(off > ip->size || off + n < off)
+  if(off > ip->size || off + n < off || (ip->flags & I_INLINE))
     return -1;
-  if(off + n > MAXFILE*BSIZE)
+  if(off + n > MAXFILESIZE)
     return -1;
+  if((grow = off + n > ip->size) != 0)
+    iprealloc(ip, off + n);
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    if((addr = bmap(ip, off/BSIZE)) == 0)
+      break;  // out of extents
+    bp = bread(ip->dev, addr);
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(bp->data + off%BSIZE, src, m);
     log_write(bp);
     brelse(bp);
   }
 
-  if(n > 0 && off > ip->size){
-    ip->size = off;
+  // Write the inode back even if the write failed part way:
+  // blocks may have been added to ip->addrs.
+  if(grow){
+    if(off > ip->size)
+      ip->size = off;
     iupdate(ip);
   }
-  return n;
+  return tot == n ? n : -1;
+}
+
+// Symbolic links.
+//
+// A target short enough to fit in addrs[] is kept there (a
+// "fast" symlink, I_INLINE), so following it reads no data
+// block. The in-memory inode also caches its target in link[],
+// which namex() reads each time a path goes through the link.
+
+// Make target the contents of symlink ip, replacing any old one.
+// Caller must hold ip->lock and be in a transaction.
+int
+writelink(struct inode *ip, char *target)
+{
+  int n;
+
+  n = strlen(target);
+  if(ip->type != T_SYMLINK || n == 0 || n >= MAXPATH)
+    return -1;
+  itrunc(ip);
+  if(n <= sizeof(ip->addrs)){
+    memmove(ip->addrs, target, n);
+    ip->flags |= I_INLINE;
+    ip->size = n;
+    iupdate(ip);
+  } else if(writei(ip, target, 0, n) != n){
+    ip->linklen = -1;
+    return -1;
+  }
+  memmove(ip->link, target, n);
+  ip->linklen = n;
+  return 0;
+}
+
+// Fill in ip->link, the target of symlink ip, if it is not
+// already cached, and return its length, or -1.
+// Caller must hold ip->lock.
+static int
+readlink(struct inode *ip)
+{
+  if(ip->linklen < 0){
+    if(ip->size == 0 || ip->size >= MAXPATH)
+      return -1;
+    if(readi(ip, ip->link, 0, ip->size) != ip->size)
+      return -1;
+    ip->linklen = ip->size;
+  }
+  return ip->linklen;
 }
 
 //PAGEBREAK!
@@ -584,6 +1239,320 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Directory entry cache.
+//
+// A hash table, indexed by directory and name, of the results of
+// recent dirlookup()s, so that looking up a name again need not
+// read the directory. An entry with inum 0 records that the name
+// is not in the directory. Each slot holds one entry; a new one
+// replaces whatever hashed to the same slot.
+//
+// Entries for a directory only change with the directory's
+// lock held: dirlookup() adds them, dirlink() and dirunlink()
+// update them, and iput() drops them when the directory is
+// freed and its inum may be reused.
+
+struct dentry {
+  uint dev;
+  uint dinum;           // directory's inode number; 0 if slot unused
+  char name[DIRSIZ];
+  uint inum;            // 0 if name is not in the directory
+  uint off;             // byte offset of the entry in the directory
+};
+
+struct {
+  struct spinlock lock;
+  struct dentry dentry[NDCACHE];
+} dcache;
+
+static void
+dcacheinit(void)
+{
+  initlock(&dcache.lock, "dcache");
+}
+
+static struct dentry*
+dhash(struct inode *dp, char *name)
+{
+  uint h;
+  int i;
+
+  h = dp->dev * 31 + dp->inum;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + name[i];
+  return &dcache.dentry[h % NDCACHE];
+}
+
+// Look up name in directory dp's cached entries. If present, set
+// *inum and *off from the entry and return 1.
+static int
+dcachelookup(struct inode *dp, char *name, uint *inum, uint *off)
+{
+  struct dentry *d;
+  int found;
+
+  acquire(&dcache.lock);
+  d = dhash(dp, name);
+  found = d->dinum == dp->inum && d->dev == dp->dev &&
+          namecmp(name, d->name) == 0;
+  if(found){
+    *inum = d->inum;
+    *off = d->off;
+    fsstats.dcachehits++;
+  } else {
+    fsstats.dcachemisses++;
+  }
+  release(&dcache.lock);
+  return found;
+}
+
+// Record that name in dp is inode inum (0 if absent) at offset off.
+static void
+dcacheset(struct inode *dp, char *name, uint inum, uint off)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  d = dhash(dp, name);
+  d->dev = dp->dev;
+  d->dinum = dp->inum;
+  strncpy(d->name, name, DIRSIZ);
+  d->inum = inum;
+  d->off = off;
+  release(&dcache.lock);
+}
+
+// Drop the cached entries of directory dp.
+static void
+dcachepurge(struct inode *dp)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  for(d = dcache.dentry; d < &dcache.dentry[NDCACHE]; d++)
+    if(d->dinum == dp->inum && d->dev == dp->dev)
+      d->dinum = 0;
+  release(&dcache.lock);
+}
+
+// Hashed directories (see struct dirhdr in fs.h).
+// A plain directory is converted when it outgrows its first
+// block, so only small directories are searched linearly.
+
+// Hash of a name. mkfs has a copy.
+static uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = (h ^ (uchar)name[i]) * 16777619;
+  return h;
+}
+
+// The bucket name belongs in.
+static uint
+dirbucket(struct dirhdr *hdr, char *name)
+{
+  uint h, b;
+
+  if(namecmp(name, ".") == 0 || namecmp(name, "..") == 0)
+    return 0;
+  h = dirhash(name);
+  b = h & ((1 << hdr->level) - 1);
+  if(b < hdr->next)
+    b = h & ((2 << hdr->level) - 1);
+  return b;
+}
+
+static void
+hdrread(struct inode *dp, struct dirhdr *hdr)
+{
+  if(readi(dp, (char*)hdr, DIRHDROFF, sizeof(*hdr)) != sizeof(*hdr))
+    panic("hdrread");
+}
+
+static void
+hdrwrite(struct inode *dp, struct dirhdr *hdr)
+{
+  if(writei(dp, (char*)hdr, DIRHDROFF, sizeof(*hdr)) != sizeof(*hdr))
+    panic("hdrwrite");
+}
+
+// First slot of bucket b that may hold a name.
+#define BUCKETSLOT0(b) ((b) == 0 ? DIRHDROFF/sizeof(struct dirent) + 1 : 0)
+
+// Look for name in bucket b of dp. If found, set *poff to the
+// entry's byte offset and return its inum, else return 0.
+static uint
+bucketlookup(struct inode *dp, uint b, char *name, uint *poff)
+{
+  struct buf *bp;
+  struct dirent *de;
+  uint i, inum;
+
+  bp = bread(dp->dev, bmap(dp, b));
+  de = (struct dirent*)bp->data;
+  inum = 0;
+  for(i = 0; i < DPB; i++){
+    if(de[i].inum != 0 && namecmp(name, de[i].name) == 0){
+      inum = de[i].inum;
+      *poff = b*BSIZE + i*sizeof(*de);
+      break;
+    }
+  }
+  brelse(bp);
+  return inum;
+}
+
+// Byte offset of a free slot in bucket b of dp, or 0 if none.
+static uint
+bucketfree(struct inode *dp, uint b)
+{
+  struct buf *bp;
+  struct dirent *de;
+  uint i, off;
+
+  bp = bread(dp->dev, bmap(dp, b));
+  de = (struct dirent*)bp->data;
+  off = 0;
+  for(i = BUCKETSLOT0(b); i < DPB; i++){
+    if(de[i].inum == 0){
+      off = b*BSIZE + i*sizeof(*de);
+      break;
+    }
+  }
+  brelse(bp);
+  return off;
+}
+
+// Add a bucket to dp by splitting bucket hdr->next: the names
+// in it that now hash to the new bucket move there.
+static void
+dirsplit(struct inode *dp, struct dirhdr *hdr)
+{
+  struct buf *bp, *nbp;
+  struct dirent *de, *nde;
+  uint old, new, i, j;
+
+  old = hdr->next;
+  new = old + (1 << hdr->level);
+  if(++hdr->next == (1 << hdr->level)){
+    hdr->level++;
+    hdr->next = 0;
+  }
+
+  nbp = bread(dp->dev, bmap(dp, new));
+  dp->size = (new + 1) * BSIZE;
+  iupdate(dp);
+  bp = bread(dp->dev, bmap(dp, old));
+  de = (struct dirent*)bp->data;
+  nde = (struct dirent*)nbp->data;
+  j = 0;
+  for(i = BUCKETSLOT0(old); i < DPB; i++){
+    if(de[i].inum == 0 || dirbucket(hdr, de[i].name) != new)
+      continue;
+    nde[j] = de[i];
+    dcacheset(dp, de[i].name, de[i].inum, new*BSIZE + j*sizeof(*de));
+    memset(&de[i], 0, sizeof(de[i]));
+    j++;
+  }
+  log_write(bp);
+  log_write(nbp);
+  brelse(bp);
+  brelse(nbp);
+}
+
+// Turn dp, a plain directory of one full block, into a hashed
+// directory of two buckets. Returns -1, changing nothing, if
+// "." and ".." are not in their usual slots.
+static int
+dirhashify(struct inode *dp)
+{
+  struct dirhdr hdr;
+  struct buf *bp, *nbp;
+  struct dirent *de, *nde;
+  uint i, j, k;
+
+  bp = bread(dp->dev, bmap(dp, 0));
+  de = (struct dirent*)bp->data;
+  if(namecmp(de[0].name, ".") != 0 || namecmp(de[1].name, "..") != 0){
+    brelse(bp);
+    return -1;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.level = 1;
+  nbp = bread(dp->dev, bmap(dp, 1));
+  nde = (struct dirent*)nbp->data;
+  j = 0;
+  for(i = 2; i < DPB; i++){
+    if(de[i].inum == 0)
+      continue;
+    hdr.nent++;
+    if(dirbucket(&hdr, de[i].name) == 1){
+      nde[j++] = de[i];
+      memset(&de[i], 0, sizeof(de[i]));
+    }
+  }
+
+  // Make room for the header.
+  i = DIRHDROFF / sizeof(*de);
+  if(de[i].inum != 0){
+    for(k = i + 1; k < DPB && de[k].inum != 0; k++)
+      ;
+    if(k < DPB){
+      de[k] = de[i];
+    } else {
+      nde[j++] = de[i];
+      hdr.nover++;
+    }
+  }
+  memmove(&de[i], &hdr, sizeof(hdr));
+
+  log_write(bp);
+  log_write(nbp);
+  brelse(bp);
+  brelse(nbp);
+  dp->flags |= I_HASHDIR;
+  dp->size = 2*BSIZE;
+  iupdate(dp);
+  dcachepurge(dp);
+  return 0;
+}
+
+// Byte offset of a free slot for name in hashed directory dp,
+// or 0 if there is none. Adds a bucket first if name's bucket
+// is full or the directory is over 3/8 full: buckets not yet
+// split hold about twice as much as split ones, and at half
+// full a few of them overflow. Counts name in the header, as
+// dirlink() is about to add it.
+static uint
+hdirslot(struct inode *dp, char *name)
+{
+  struct dirhdr hdr;
+  uint b, nb, off;
+
+  hdrread(dp, &hdr);
+  nb = (1 << hdr.level) + hdr.next;
+  off = bucketfree(dp, dirbucket(&hdr, name));
+  if((off == 0 || hdr.nent * 8 >= nb * DPB * 3) && nb < MAXFILE){
+    dirsplit(dp, &hdr);
+    off = bucketfree(dp, dirbucket(&hdr, name));
+  }
+  for(b = 0; off == 0 && b < dp->size / BSIZE; b++)
+    off = bucketfree(dp, b);
+  if(off == 0)
+    return 0;
+  if(off / BSIZE != dirbucket(&hdr, name))
+    hdr.nover++;
+  hdr.nent++;
+  hdrwrite(dp, &hdr);
+  return off;
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 struct inode*
@@ -591,32 +1560,48 @@ dirlookup(struct inode *dp, char *name, uint *poff)
 {
   uint off, inum;
   struct dirent de;
+  struct dirhdr hdr;
+  int scan;
 
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
-  for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlookup read");
-    if(de.inum == 0)
-      continue;
-    if(namecmp(name, de.name) == 0){
-      // entry matches path element
-      if(poff)
-        *poff = off;
-      inum = de.inum;
-      return iget(dp->dev, inum);
+  if(!dcachelookup(dp, name, &inum, &off)){
+    inum = 0;
+    scan = 1;
+    if(dp->flags & I_HASHDIR){
+      hdrread(dp, &hdr);
+      inum = bucketlookup(dp, dirbucket(&hdr, name), name, &off);
+      scan = inum == 0 && hdr.nover > 0;
+    }
+    if(scan){
+      for(off = 0; off < dp->size; off += sizeof(de)){
+        if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+          panic("dirlookup read");
+        if(de.inum == 0)
+          continue;
+        if(namecmp(name, de.name) == 0){
+          // entry matches path element
+          inum = de.inum;
+          break;
+        }
+      }
     }
+    dcacheset(dp, name, inum, inum ? off : 0);
   }
 
-  return 0;
+  if(inum == 0)
+    return 0;
+  if(poff)
+    *poff = off;
+  return iget(dp->dev, inum);
 }
 
 // Write a new directory entry (name, inum) into the directory dp.
 int
 dirlink(struct inode *dp, char *name, uint inum)
 {
-  int off;
+  uint off;
   struct dirent de;
   struct inode *ip;
 
@@ -626,22 +1611,54 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
-  // Look for an empty dirent.
-  for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlink read");
-    if(de.inum == 0)
-      break;
+  if(!(dp->flags & I_HASHDIR)){
+    // Look for an empty dirent.
+    for(off = 0; off < dp->size; off += sizeof(de)){
+      if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+        panic("dirlink read");
+      if(de.inum == 0)
+        break;
+    }
+    // Hash the directory rather than grow it past one block.
+    if(off == BSIZE && dp->size == BSIZE)
+      dirhashify(dp);
+  }
+  if(dp->flags & I_HASHDIR){
+    if((off = hdirslot(dp, name)) == 0)
+      return -1;
   }
 
   strncpy(de.name, name, DIRSIZ);
   de.inum = inum;
   if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
     panic("dirlink");
+  dcacheset(dp, name, inum, off);
 
   return 0;
 }
 
+// Remove the entry for name, at byte offset off, from the
+// directory dp.
+void
+dirunlink(struct inode *dp, char *name, uint off)
+{
+  struct dirent de;
+  struct dirhdr hdr;
+
+  memset(&de, 0, sizeof(de));
+  if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+    panic("unlink: writei");
+  dcacheset(dp, name, 0, 0);
+
+  if(dp->flags & I_HASHDIR){
+    hdrread(dp, &hdr);
+    hdr.nent--;
+    if(off / BSIZE != dirbucket(&hdr, name))
+      hdr.nover--;
+    hdrwrite(dp, &hdr);
+  }
+}
+
 //PAGEBREAK!
 // Paths
 
@@ -682,20 +1699,46 @@ skipelem(char *path, char *name)
   return path;
 }
 
+// Replace the path element just looked up, a symlink ip, with
+// its target: rewrite the rest of the path, rest, as target/rest
+// in buf, which has room for MAXPATH bytes and may already hold
+// rest. Returns the new path, or 0 if it does not fit.
+static char*
+followlink(struct inode *ip, char *rest, char *buf)
+{
+  int n, len;
+
+  if((n = readlink(ip)) < 0)
+    return 0;
+  len = strlen(rest);
+  if(n + 1 + len + 1 > MAXPATH)
+    return 0;
+  memmove(buf + n + 1, rest, len + 1);
+  memmove(buf, ip->link, n);
+  buf[n] = '/';
+  return buf;
+}
+
 // Look up and return the inode for a path name.
 // If parent != 0, return the inode for the parent and copy the final
 // path element into name, which must have room for DIRSIZ bytes.
+// Symlinks are followed wherever they appear, except as the final
+// element when follow is 0; a relative target is looked up in the
+// directory holding the link.
 // Must be called inside a transaction since it calls iput().
 static struct inode*
-namex(char *path, int nameiparent, char *name)
+namex(char *path, int nameiparent, int follow, char *name)
 {
   struct inode *ip, *next;
+  char buf[MAXPATH];
+  int nlinks;
 
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
   else
     ip = idup(myproc()->cwd);
 
+  nlinks = 0;
   while((path = skipelem(path, name)) != 0){
     ilock(ip);
     if(ip->type != T_DIR){
@@ -711,7 +1754,24 @@ namex(char *path, int nameiparent, char *name)
       iunlockput(ip);
       return 0;
     }
-    iunlockput(ip);
+    iunlock(ip);
+
+    ilock(next);
+    if(next->type == T_SYMLINK && (*path != '\0' || follow)){
+      if(++nlinks > MAXSYMLINKS || (path = followlink(next, path, buf)) == 0){
+        iunlockput(next);
+        iput(ip);
+        return 0;
+      }
+      iunlockput(next);
+      if(*path == '/'){
+        iput(ip);
+        ip = iget(ROOTDEV, ROOTINO);
+      }
+      continue;
+    }
+    iunlock(next);
+    iput(ip);
     ip = next;
   }
   if(nameiparent){
@@ -725,11 +1785,20 @@ struct inode*
 namei(char *path)
 {
   char name[DIRSIZ];
-  return namex(path, 0, name);
+  return namex(path, 0, 1, name);
+}
+
+// Like namei(), but if the final element is a symlink,
+// return the link itself.
+struct inode*
+nameinofollow(char *path)
+{
+  char name[DIRSIZ];
+  return namex(path, 0, 0, name);
 }
 
 struct inode*
 nameiparent(char *path, char *name)
 {
-  return namex(path, 1, name);
+  return namex(path, 1, 0, name);
 }
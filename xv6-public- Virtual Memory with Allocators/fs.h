@@ -3,7 +3,7 @@
 
 
 #define ROOTINO 1  // root i-number
-#define BSIZE 512  // block size
+#define BSIZE 4096  // block size; at most a page
 
 // File types
 #define T_DIR    1   // Directory
@@ -16,6 +16,9 @@
 // mkfs computes the super block and builds an initial file system. The
 // super block describes the disk layout:
 struct superblock {
+  uint magic;        // Must be FSMAGIC
+  uint version;      // Format version, FSVERSION
+  uint bsize;        // Block size, BSIZE
   uint size;         // Size of file system image (blocks)
   uint nblocks;      // Number of data blocks
   uint ninodes;      // Number of inodes.
@@ -25,13 +28,20 @@ struct superblock {
   uint bmapstart;    // Block number of first free map block
 };
 
+#define FSMAGIC 0x10203040
+#define FSVERSION 2  // 1 was the unversioned 512-byte-block format
+
 #define NDIRECT 10
 #define NINDIRECT (BSIZE / sizeof(uint))
 #define NDINDIRECT (NINDIRECT * NINDIRECT)
 #define MAXFILE (NDIRECT + NINDIRECT + 2*NDINDIRECT)
+// Largest file in bytes: MAXFILE blocks, as long as that fits in
+// the uint size of an inode.
+#define MAXFILESIZE (MAXFILE < 0xffffffffU/BSIZE ? MAXFILE*BSIZE : 0xffffffffU)
 // On-disk inode structure
 struct dinode {
-  short type;           // File type
+  uchar type;           // File type
+  uchar flags;          // Inode flags (I_*)
   short major;          // Major device number (T_DEV only)
   short minor;          // Minor device number (T_DEV only)
   short nlink;          // Number of links to inode in file system
@@ -40,7 +50,26 @@ struct dinode {
                        // - NDIRECT direct blocks
                        // - 1 indirect block
                        // - 2 double-indirect blocks
+                       // or, with I_EXTENT, NEXTENT extents
+                       // and the address of an extent block
+                       // or, with I_INLINE, a symlink target
+};
+
+// Inode flags
+#define I_EXTENT 0x1  // addrs[] holds extents, not block addresses
+#define I_HASHDIR 0x2 // directory blocks are hash buckets
+#define I_INLINE 0x4  // symlink target is in addrs[], not a block
+
+// An extent maps the next len blocks of a file to the disk
+// blocks start..start+len-1. A file's extents cover its blocks
+// in order, the first NEXTENT in the inode and the rest in the
+// block at addrs[NEXTENT*2]. Unused extents have len 0.
+struct extent {
+  uint start;
+  uint len;
 };
+#define NEXTENT ((NDIRECT+2) / 2)
+#define NEXTENTBLK (BSIZE / sizeof(struct extent))
 
 // Inodes per block.
 #define IPB           (BSIZE / sizeof(struct dinode))
@@ -62,3 +91,24 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// Directory entries per block.
+#define DPB           (BSIZE / sizeof(struct dirent))
+
+// A directory with I_HASHDIR set is still a sequence of dirents,
+// but each of its blocks is a bucket of a linear hash table,
+// holding the names that dirhash() sends there. Slots 0 and 1
+// hold "." and "..", and slot 2 this header, whose inum of 0
+// makes plain readers of the directory skip it. There are
+// (1 << level) + next buckets; bucket b < next has been split
+// into b and b + (1 << level). A name whose bucket was full is
+// put in any free slot and counted in nover.
+struct dirhdr {
+  ushort inum;      // always 0
+  ushort level;
+  ushort next;
+  ushort nover;     // names not in their own bucket
+  uint nent;        // names, not counting "." and ".."
+  char pad[DIRSIZ - 10];
+};
+#define DIRHDROFF (2 * sizeof(struct dirent))
+
@@ -0,0 +1,491 @@
+// File system benchmarks.
+// Each workload prints the elapsed ticks and the disk and log
+// traffic it caused, taken from fsstat() before and after.
+//
+//   fsbench createdelete [rounds]
+//   fsbench stressfs [rounds]
+//   fsbench randread [rounds]
+//   fsbench pread [rounds]
+//   fsbench rmbig [rounds]
+//   fsbench lookup [rounds]
+//   fsbench bigdir [rounds]
+//   fsbench records [rounds]
+//   fsbench sendfile [rounds]
+//   fsbench bigfile [rounds]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "fs.h"
+
+#define NCHILD 4
+
+struct fsstat st0;
+int t0;
+
+void
+start(char *name)
+{
+  printf(1, "%s: ", name);
+  fsstat(&st0);
+  t0 = uptime();
+}
+
+void
+stop(void)
+{
+  struct fsstat st;
+  int t, commits;
+
+  t = uptime() - t0;
+  fsstat(&st);
+  commits = st.commits - st0.commits;
+  printf(1, "%d ticks\n", t);
+  printf(1, "  commits %d logwrites %d checkpoints %d installs %d absorbed %d\n",
+         commits, st.logwrites - st0.logwrites,
+         st.checkpoints - st0.checkpoints, st.installs - st0.installs,
+         st.absorbed - st0.absorbed);
+  printf(1, "  disk cmds %d reads %d writes %d",
+         st.diskcmds - st0.diskcmds, st.diskreads - st0.diskreads,
+         st.diskwrites - st0.diskwrites);
+  if(commits > 0)
+    printf(1, " (%d writes/100 commits)",
+           (st.diskwrites - st0.diskwrites) * 100 / commits);
+  printf(1, "\n");
+  printf(1, "  bmap hits %d misses %d\n",
+         st.bmaphits - st0.bmaphits, st.bmapmisses - st0.bmapmisses);
+  printf(1, "  dcache hits %d misses %d\n",
+         st.dcachehits - st0.dcachehits, st.dcachemisses - st0.dcachemisses);
+  printf(1, "  icache hits %d misses %d\n",
+         st.icachehits - st0.icachehits, st.icachemisses - st0.icachemisses);
+}
+
+uint seed = 1;
+
+uint
+rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+// Like usertests' createdelete: NCHILD processes each create
+// 20 files and unlink every other one as they go.
+void
+createdelete(int rounds)
+{
+  enum { N = 20 };
+  char name[3];
+  int r, pi, i, fd;
+
+  start("createdelete");
+  for(r = 0; r < rounds; r++){
+    for(pi = 0; pi < NCHILD; pi++){
+      if(fork() == 0){
+        name[0] = 'p' + pi;
+        name[2] = '\0';
+        for(i = 0; i < N; i++){
+          name[1] = '0' + i;
+          if((fd = open(name, O_CREATE | O_RDWR)) < 0){
+            printf(1, "fsbench: create %s failed\n", name);
+            exit();
+          }
+          close(fd);
+          if(i > 0 && (i % 2) == 0){
+            name[1] = '0' + (i / 2);
+            unlink(name);
+          }
+        }
+        exit();
+      }
+    }
+    for(pi = 0; pi < NCHILD; pi++)
+      wait();
+    name[2] = '\0';
+    for(pi = 0; pi < NCHILD; pi++){
+      name[0] = 'p' + pi;
+      for(i = 0; i < N; i++){
+        name[1] = '0' + i;
+        unlink(name);
+      }
+    }
+  }
+  stop();
+}
+
+// Like stressfs: NCHILD processes each write and read back
+// a 20-block file.
+void
+stressfs(int rounds)
+{
+  char path[] = "stressfs0";
+  char data[512];
+  int r, pi, i, fd;
+
+  memset(data, 'a', sizeof(data));
+  start("stressfs");
+  for(r = 0; r < rounds; r++){
+    for(pi = 0; pi < NCHILD; pi++){
+      if(fork() == 0){
+        path[8] = '0' + pi;
+        fd = open(path, O_CREATE | O_RDWR);
+        for(i = 0; i < 20; i++)
+          write(fd, data, sizeof(data));
+        close(fd);
+        fd = open(path, O_RDONLY);
+        for(i = 0; i < 20; i++)
+          read(fd, data, sizeof(data));
+        close(fd);
+        unlink(path);
+        exit();
+      }
+    }
+    for(pi = 0; pi < NCHILD; pi++)
+      wait();
+  }
+  stop();
+}
+
+// Write a file of nblk 512-byte blocks.
+void
+mkfile(char *name, int nblk)
+{
+  char data[512];
+  int i, fd;
+
+  memset(data, 'r', sizeof(data));
+  fd = open(name, O_CREATE | O_RDWR);
+  for(i = 0; i < nblk; i++){
+    if(write(fd, data, sizeof(data)) != sizeof(data)){
+      printf(1, "fsbench: write %s failed\n", name);
+      exit();
+    }
+  }
+  close(fd);
+}
+
+// Like lseektest, but over a 4MB file, most of it behind the
+// indirect block: seek to a random 512 bytes and read them, 100
+// times per round.
+void
+randread(int rounds)
+{
+  enum { NBLK = 8192 };
+  char data[512];
+  int i, fd;
+
+  mkfile("randread", NBLK);
+  fd = open("randread", O_RDONLY);
+  start("randread");
+  for(i = 0; i < rounds * 100; i++){
+    lseek(fd, (rand() % NBLK) * sizeof(data), SEEK_SET);
+    read(fd, data, sizeof(data));
+  }
+  stop();
+  close(fd);
+  unlink("randread");
+}
+
+// randread with NCHILD processes sharing one open file, each
+// pread()ing 100 random blocks per round.
+void
+preadbench(int rounds)
+{
+  enum { NBLK = 8192 };
+  char data[512];
+  int i, pi, fd;
+
+  mkfile("pread", NBLK);
+  fd = open("pread", O_RDONLY);
+  start("pread");
+  for(pi = 0; pi < NCHILD; pi++){
+    if(fork() == 0){
+      seed = pi + 1;
+      for(i = 0; i < rounds * 100; i++){
+        if(pread(fd, data, sizeof(data), (rand() % NBLK) * sizeof(data)) != sizeof(data)){
+          printf(1, "fsbench: pread failed\n");
+          exit();
+        }
+      }
+      exit();
+    }
+  }
+  for(pi = 0; pi < NCHILD; pi++)
+    wait();
+  stop();
+  printf(1, "  %d reads of %d bytes\n", NCHILD * rounds * 100, sizeof(data));
+  close(fd);
+  unlink("pread");
+}
+
+// Write a 16MB file, reaching into the double-indirect blocks,
+// and time just its unlink, which leaves the freeing of its
+// blocks to the reclaim thread.
+void
+rmbig(int rounds)
+{
+  enum { NBLK = 32768 };
+  char data[512];
+  int r, i, fd, t;
+
+  memset(data, 'b', sizeof(data));
+  t = 0;
+  for(r = 0; r < rounds; r++){
+    fd = open("rmbig", O_CREATE | O_RDWR);
+    for(i = 0; i < NBLK; i++){
+      if(write(fd, data, sizeof(data)) != sizeof(data)){
+        printf(1, "fsbench: write rmbig failed\n");
+        exit();
+      }
+    }
+    close(fd);
+    t -= uptime();
+    unlink("rmbig");
+    t += uptime();
+  }
+  printf(1, "rmbig: %d ticks in unlink\n", t);
+}
+
+// Path lookups: open each of 20 files two directories down and a
+// name that does not exist, 100 times per round.
+void
+lookup(int rounds)
+{
+  enum { N = 20 };
+  char path[] = "lookupd/d/f00";
+  int r, i, fd;
+
+  mkdir("lookupd");
+  mkdir("lookupd/d");
+  for(i = 0; i < N; i++){
+    path[11] = '0' + i / 10;
+    path[12] = '0' + i % 10;
+    close(open(path, O_CREATE | O_RDWR));
+  }
+
+  start("lookup");
+  for(r = 0; r < rounds * 100; r++){
+    for(i = 0; i < N; i++){
+      path[11] = '0' + i / 10;
+      path[12] = '0' + i % 10;
+      if((fd = open(path, O_RDONLY)) < 0){
+        printf(1, "fsbench: open %s failed\n", path);
+        exit();
+      }
+      close(fd);
+    }
+    if(open("lookupd/d/nofile", O_RDONLY) >= 0){
+      printf(1, "fsbench: opened lookupd/d/nofile\n");
+      exit();
+    }
+  }
+  stop();
+
+  for(i = 0; i < N; i++){
+    path[11] = '0' + i / 10;
+    path[12] = '0' + i % 10;
+    unlink(path);
+  }
+  unlink("lookupd/d");
+  unlink("lookupd");
+}
+
+// Append 100 records per round, each a 16-byte header and a
+// 200-byte payload, first with two write()s per record and then
+// with one writev(), which commits both in one transaction.
+void
+records(int rounds)
+{
+  char hdr[16], data[200];
+  struct iovec iov[2];
+  int i, v, fd;
+
+  memset(hdr, 'h', sizeof(hdr));
+  memset(data, 'd', sizeof(data));
+  iov[0].base = hdr;
+  iov[0].len = sizeof(hdr);
+  iov[1].base = data;
+  iov[1].len = sizeof(data);
+  for(v = 0; v < 2; v++){
+    fd = open("records", O_CREATE | O_RDWR);
+    start(v == 0 ? "records write" : "records writev");
+    for(i = 0; i < rounds * 100; i++){
+      if(v == 0 ? write(fd, hdr, sizeof(hdr)) != sizeof(hdr) ||
+                  write(fd, data, sizeof(data)) != sizeof(data)
+                : writev(fd, iov, 2) != sizeof(hdr) + sizeof(data)){
+        printf(1, "fsbench: write records failed\n");
+        exit();
+      }
+    }
+    stop();
+    close(fd);
+    unlink("records");
+  }
+}
+
+// Push a 1MB file through a pipe to a child that throws it away,
+// once per round, first with read() and write() of 2KB at a time,
+// as cat did, and then with sendfile(). Prints the rate in KB/s.
+void
+sendfilebench(int rounds)
+{
+  enum { NBLK = 2048 };
+  char data[2048];
+  int v, r, n, fd, p[2], t;
+
+  mkfile("sendfile", NBLK);
+  for(v = 0; v < 2; v++){
+    if(pipe(p) < 0){
+      printf(1, "fsbench: pipe failed\n");
+      exit();
+    }
+    if(fork() == 0){
+      close(p[1]);
+      while(read(p[0], data, sizeof(data)) > 0)
+        ;
+      exit();
+    }
+    close(p[0]);
+    start(v == 0 ? "sendfile read+write" : "sendfile");
+    for(r = 0; r < rounds; r++){
+      fd = open("sendfile", O_RDONLY);
+      if(v == 0){
+        while((n = read(fd, data, sizeof(data))) > 0)
+          write(p[1], data, n);
+      } else {
+        while(sendfile(p[1], fd, -1, NBLK * 512) > 0)
+          ;
+      }
+      close(fd);
+    }
+    close(p[1]);
+    wait();
+    t = uptime() - t0;
+    stop();
+    if(t > 0)
+      printf(1, "  %d KB/s\n", rounds * NBLK / 2 * 100 / t);
+  }
+  unlink("sendfile");
+}
+
+// Write a file of rounds megabytes with 4KB writes and read it
+// back, printing the rate of each in KB/s, and the largest file
+// the format allows.
+void
+bigfile(int rounds)
+{
+  static char data[4096];
+  int i, n, fd, t;
+
+  printf(1, "bigfile: block size %d, largest file %d KB\n",
+         BSIZE, MAXFILESIZE / 1024);
+  n = rounds * 1024 * 1024 / sizeof(data);
+  fd = open("bigfile", O_CREATE | O_RDWR);
+  start("bigfile write");
+  for(i = 0; i < n; i++){
+    if(write(fd, data, sizeof(data)) != sizeof(data)){
+      printf(1, "fsbench: write bigfile failed\n");
+      exit();
+    }
+  }
+  t = uptime() - t0;
+  stop();
+  if(t > 0)
+    printf(1, "  %d KB/s\n", rounds * 1024 * 100 / t);
+  close(fd);
+
+  fd = open("bigfile", O_RDONLY);
+  start("bigfile read");
+  for(i = 0; i < n; i++){
+    if(read(fd, data, sizeof(data)) != sizeof(data)){
+      printf(1, "fsbench: read bigfile failed\n");
+      exit();
+    }
+  }
+  t = uptime() - t0;
+  stop();
+  if(t > 0)
+    printf(1, "  %d KB/s\n", rounds * 1024 * 100 / t);
+  close(fd);
+  unlink("bigfile");
+}
+
+// Create 500 files per round in one directory, printing the
+// ticks each 500 took, then remove them all. Without hashed
+// directories each create scans the whole directory.
+void
+bigdir(int rounds)
+{
+  enum { N = 500 };
+  char path[] = "bigdir/f00000";
+  int r, i, n, fd, t;
+
+  mkdir("bigdir");
+  start("bigdir");
+  printf(1, "\n");
+  n = 0;
+  for(r = 0; r < rounds; r++){
+    t = uptime();
+    for(i = 0; i < N; i++, n++){
+      path[8] = '0' + n / 10000 % 10;
+      path[9] = '0' + n / 1000 % 10;
+      path[10] = '0' + n / 100 % 10;
+      path[11] = '0' + n / 10 % 10;
+      path[12] = '0' + n % 10;
+      if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+        printf(1, "fsbench: create %s failed\n", path);
+        exit();
+      }
+      close(fd);
+    }
+    printf(1, "  %d files: %d ticks\n", n, uptime() - t);
+  }
+  stop();
+
+  while(n-- > 0){
+    path[8] = '0' + n / 10000 % 10;
+    path[9] = '0' + n / 1000 % 10;
+    path[10] = '0' + n / 100 % 10;
+    path[11] = '0' + n / 10 % 10;
+    path[12] = '0' + n % 10;
+    unlink(path);
+  }
+  unlink("bigdir");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds;
+
+  if(argc < 2){
+    printf(2, "usage: fsbench createdelete|stressfs|randread|pread|rmbig|lookup|bigdir|records|sendfile|bigfile [rounds]\n");
+    exit();
+  }
+  rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+  if(strcmp(argv[1], "createdelete") == 0)
+    createdelete(rounds);
+  else if(strcmp(argv[1], "stressfs") == 0)
+    stressfs(rounds);
+  else if(strcmp(argv[1], "randread") == 0)
+    randread(rounds);
+  else if(strcmp(argv[1], "pread") == 0)
+    preadbench(rounds);
+  else if(strcmp(argv[1], "rmbig") == 0)
+    rmbig(rounds);
+  else if(strcmp(argv[1], "lookup") == 0)
+    lookup(rounds);
+  else if(strcmp(argv[1], "bigdir") == 0)
+    bigdir(rounds);
+  else if(strcmp(argv[1], "records") == 0)
+    records(rounds);
+  else if(strcmp(argv[1], "sendfile") == 0)
+    sendfilebench(rounds);
+  else if(strcmp(argv[1], "bigfile") == 0)
+    bigfile(rounds);
+  else
+    printf(2, "fsbench: unknown workload %s\n", argv[1]);
+  exit();
+}
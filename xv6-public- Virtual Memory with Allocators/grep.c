@@ -1,37 +1,237 @@
 // Simple grep.  Only supports ^ . * $ operators.
+//
+// The pattern is compiled once into a bit-parallel matcher
+// (Shift-And): bit i of a state word is set when the text read so
+// far can end with a match of the first i+1 tokens. A pattern that
+// starts with literal characters is first searched for as a string
+// over the whole buffer, so lines without it are never looked at.
 
 #include "types.h"
 #include "stat.h"
 #include "user.h"
 
-char buf[1024];
+#define NTOKEN 32  // tokens in a compiled pattern: bits in a uint
+
+char buf[64*1024 + 1];  // +1 for match()'s nul
+char obuf[8192];
+int nobuf;
+
+// The compiled pattern. A token is a character or '.', maybe
+// followed by '*'.
+struct {
+  int bol;          // pattern began with ^
+  int eol;          // pattern ended with $
+  uint b[256];      // tokens that match each byte
+  uint star;        // starred tokens
+  uint last;        // tokens followed only by starred ones
+  int empty;        // every token is starred
+  int nstep;        // longest run of starred tokens
+  char lit[NTOKEN]; // unstarred characters the pattern starts with
+  int nlit;
+  int skip[256];    // Horspool shifts for lit
+} re;
+char *kp;           // pattern, when too long to compile
+
 int match(char*, char*);
 
+// Compile pattern p into re. Returns -1 if it is too long.
+int
+compile(char *p)
+{
+  int n, c, i, run;
+
+  memset(&re, 0, sizeof(re));
+  if(*p == '^'){
+    re.bol = 1;
+    p++;
+  }
+  for(n = 0; *p; n++){
+    if(p[0] == '$' && p[1] == '\0'){
+      re.eol = 1;
+      break;
+    }
+    if(n == NTOKEN)
+      return -1;
+    c = (uchar)*p++;
+    if(c == '.'){
+      for(i = 1; i < 256; i++)
+        re.b[i] |= 1 << n;
+    } else
+      re.b[c] |= 1 << n;
+    if(*p == '*'){
+      re.star |= 1 << n;
+      p++;
+    } else if(c != '.' && re.nlit == n && !re.bol)
+      re.lit[re.nlit++] = c;
+  }
+
+  for(i = n-1; i >= 0; i--){
+    re.last |= 1 << i;
+    if(!(re.star & (1 << i)))
+      break;
+  }
+  re.empty = i < 0;
+  for(i = run = 0; i < n; i++){
+    run = (re.star & (1 << i)) ? run+1 : 0;
+    if(run > re.nstep)
+      re.nstep = run;
+  }
+  for(i = 0; i < 256; i++)
+    re.skip[i] = re.nlit;
+  for(i = 0; i < re.nlit-1; i++)
+    re.skip[(uchar)re.lit[i]] = re.nlit-1 - i;
+  return 0;
+}
+
+// Does the line s[0..n) match re?
+int
+run(char *s, int n)
+{
+  uint d, en;
+  int i, k;
+
+  d = 0;
+  for(i = 0; i < n; i++){
+    if(!re.eol && ((d & re.last) || (re.empty && (!re.bol || i == 0))))
+      return 1;
+    en = d << 1;
+    if(!re.bol || i == 0)
+      en |= 1;
+    for(k = 0; k < re.nstep; k++)
+      en |= (en & re.star) << 1;  // a starred token may be skipped
+    d = (en | (d & re.star)) & re.b[(uchar)s[i]];
+    if(d == 0 && re.bol)
+      return 0;
+  }
+  return (d & re.last) || (re.empty && (!re.bol || n == 0));
+}
+
+int
+matches(char *s, int n)
+{
+  char c;
+  int r;
+
+  if(kp == 0)
+    return run(s, n);
+  c = s[n];
+  s[n] = '\0';
+  r = match(kp, s);
+  s[n] = c;
+  return r;
+}
+
+// Find the first c in [s, e), a word at a time.
+char*
+findc(char *s, char *e, int c)
+{
+  uint w, pat;
+
+  for(; s < e && ((uint)s & 3); s++)
+    if(*s == c)
+      return s;
+  pat = (uchar)c * 0x01010101;
+  for(; s + 4 <= e; s += 4){
+    w = *(uint*)s ^ pat;
+    if((w - 0x01010101) & ~w & 0x80808080)  // a zero byte
+      break;
+  }
+  for(; s < e; s++)
+    if(*s == c)
+      return s;
+  return 0;
+}
+
+// Find re.lit in [s, e).
+char*
+findlit(char *s, char *e)
+{
+  char *p;
+  int i, n;
+
+  n = re.nlit;
+  if(n == 1)
+    return findc(s, e, re.lit[0]);
+  for(p = s; p + n <= e; p += re.skip[(uchar)p[n-1]]){
+    for(i = n-1; i >= 0 && p[i] == re.lit[i]; i--)
+      ;
+    if(i < 0)
+      return p;
+  }
+  return 0;
+}
+
 void
-grep(char *pattern, int fd)
+flush(void)
 {
-  int n, m;
-  char *p, *q;
+  if(nobuf > 0)
+    write(1, obuf, nobuf);
+  nobuf = 0;
+}
 
-  m = 0;
-  while((n = read(fd, buf+m, sizeof(buf)-m-1)) > 0){
-    m += n;
-    buf[m] = '\0';
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){
-      *q = 0;
-      if(match(pattern, p)){
-        *q = '\n';
-        write(1, p, q+1 - p);
-      }
-      p = q+1;
+// Print the line s[0..n).
+void
+emit(char *s, int n)
+{
+  if(nobuf + n + 1 > sizeof(obuf))
+    flush();
+  if(n + 1 > sizeof(obuf)){
+    write(1, s, n);
+    write(1, "\n", 1);
+    return;
+  }
+  memmove(obuf + nobuf, s, n);
+  nobuf += n;
+  obuf[nobuf++] = '\n';
+}
+
+// Print the matching lines in [s, e). Unless all is set, stop at
+// a last line with no newline and return where it starts.
+char*
+lines(char *s, char *e, int all)
+{
+  char *p, *nl;
+
+  while(s < e){
+    if(re.nlit > 0 && kp == 0){
+      if((p = findlit(s, e)) == 0)
+        p = e;
+      while(p > s && p[-1] != '\n')
+        p--;
+      s = p;
+      if(s == e)
+        break;
     }
-    if(p == buf)
-      m = 0;
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
+    if((nl = findc(s, e, '\n')) == 0){
+      if(!all)
+        return s;
+      nl = e;
     }
+    if(matches(s, nl - s))
+      emit(s, nl - s);
+    s = nl + 1;
+  }
+  return e;
+}
+
+void
+grep(int fd)
+{
+  int n, m;
+  char *p;
+
+  m = 0;
+  for(;;){
+    n = read(fd, buf+m, sizeof(buf)-1-m);
+    if(n > 0)
+      m += n;
+    p = lines(buf, buf+m, n <= 0);
+    if(p == buf && m == sizeof(buf)-1)
+      p = lines(buf, buf+m, 1);  // a line longer than buf
+    if(n <= 0)
+      break;
+    m -= p - buf;
+    memmove(buf, p, m);
   }
 }
 
@@ -39,32 +239,36 @@ int
 main(int argc, char *argv[])
 {
   int fd, i;
-  char *pattern;
 
   if(argc <= 1){
     printf(2, "usage: grep pattern [file ...]\n");
     exit();
   }
-  pattern = argv[1];
+  if(compile(argv[1]) < 0)
+    kp = argv[1];
 
   if(argc <= 2){
-    grep(pattern, 0);
+    grep(0);
+    flush();
     exit();
   }
 
   for(i = 2; i < argc; i++){
     if((fd = open(argv[i], 0)) < 0){
+      flush();
       printf(1, "grep: cannot open %s\n", argv[i]);
       exit();
     }
-    grep(pattern, fd);
+    grep(fd);
     close(fd);
   }
+  flush();
   exit();
 }
 
 // Regexp matcher from Kernighan & Pike,
 // The Practice of Programming, Chapter 9.
+// Used for patterns of more than NTOKEN tokens.
 
 int matchhere(char*, char*);
 int matchstar(int, char*, char*);
@@ -104,4 +308,3 @@ int matchstar(int c, char *re, char *text)
   }while(*text!='\0' && (*text++==c || c=='.'));
   return 0;
 }
-
@@ -0,0 +1,114 @@
+// grep throughput: write a file of text lines, then time grep on
+// it with a few kinds of pattern, its output going to a file.
+// Prints the rate in MB/s.
+//
+//   grepbench [megabytes]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+char *words[] = {
+  "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+  "lorem", "ipsum", "dolor", "sit", "amet", "hay", "stack", "xv6",
+};
+char *patterns[] = {
+  "needle",        // literal, rare
+  "ipsum dolor",   // literal, common
+  "^the",          // anchored
+  "q.*z",          // no literal prefix
+  "o.*o.*o",
+};
+
+char buf[4096];
+uint seed = 1;
+
+uint
+rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+// Write about size bytes of lines of random words, one line in
+// 1000 ending in "needle".
+void
+mkfile(char *name, int size)
+{
+  int fd, n, nline, k;
+  char *w;
+
+  unlink(name);
+  if((fd = open(name, O_CREATE | O_WRONLY)) < 0){
+    printf(1, "grepbench: cannot create %s\n", name);
+    exit();
+  }
+  n = nline = 0;
+  while(size > 0){
+    for(k = rand() % 12; k > 0; k--){
+      for(w = words[rand() % NELEM(words)]; *w; w++)
+        buf[n++] = *w;
+      buf[n++] = ' ';
+    }
+    if(++nline % 1000 == 0){
+      memmove(buf + n, "needle", 6);
+      n += 6;
+    }
+    buf[n++] = '\n';
+    if(n > sizeof(buf) - 128){
+      if(write(fd, buf, n) != n){
+        printf(1, "grepbench: write failed\n");
+        exit();
+      }
+      size -= n;
+      n = 0;
+    }
+  }
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb, i, t, fd;
+  char *argv2[4];
+  struct stat st;
+
+  mb = argc > 1 ? atoi(argv[1]) : 4;
+  mkfile("grepbench.dat", mb * 1024 * 1024);
+  if(stat("grepbench.dat", &st) < 0){
+    printf(1, "grepbench: stat failed\n");
+    exit();
+  }
+  printf(1, "%d KB of text\n", st.size / 1024);
+
+  for(i = 0; i < NELEM(patterns); i++){
+    unlink("grepbench.out");
+    t = uptime();
+    if(fork() == 0){
+      close(1);
+      if((fd = open("grepbench.out", O_CREATE | O_WRONLY)) != 1)
+        exit();
+      argv2[0] = "grep";
+      argv2[1] = patterns[i];
+      argv2[2] = "grepbench.dat";
+      argv2[3] = 0;
+      exec("grep", argv2);
+      exit();
+    }
+    wait();
+    t = uptime() - t;
+    if(stat("grepbench.out", &st) < 0)
+      st.size = 0;
+    printf(1, "%s: %d ticks, %d KB out", patterns[i], t, st.size / 1024);
+    if(t > 0)
+      printf(1, ", %d.%d MB/s", mb * 100 / t, mb * 1000 / t % 10);
+    printf(1, "\n");
+  }
+  unlink("grepbench.out");
+  unlink("grepbench.dat");
+  exit();
+}
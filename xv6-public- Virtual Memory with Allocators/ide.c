@@ -11,6 +11,7 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
+#include "stat.h"
 #include "buf.h"
 
 #define SECTOR_SIZE   512
@@ -69,31 +70,46 @@ ideinit(void)
   outb(0x1f6, 0xe0 | (0<<4));
 }
 
-// Start the request for b.  Caller must hold idelock.
+// Start the request for b and the rest of its run (b->rnext...).
+// Caller must hold idelock.
 static void
 idestart(struct buf *b)
 {
+  struct buf *r;
+  int nblocks;
+
   if(b == 0)
     panic("idestart");
-  if(b->blockno >= FSSIZE)
+  nblocks = 0;
+  for(r = b; r; r = r->rnext)
+    nblocks++;
+  if(nblocks > BRUNMAX)
+    panic("idestart: run too long");
+  if(b->blockno + nblocks > FSSIZE)
     panic("incorrect blockno");
   int sector_per_block =  BSIZE/SECTOR_SIZE;
   int sector = b->blockno * sector_per_block;
-  int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
-  int write_cmd = (sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
+  int nsector = nblocks * sector_per_block;
+  int read_cmd = (nsector == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
+  int write_cmd = (nsector == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
 
-  if (sector_per_block > 7) panic("idestart");
+  fsstats.diskcmds++;
+  if(b->flags & B_DIRTY)
+    fsstats.diskwrites += nblocks;
+  else
+    fsstats.diskreads += nblocks;
 
   idewait(0);
   outb(0x3f6, 0);  // generate interrupt
-  outb(0x1f2, sector_per_block);  // number of sectors
+  outb(0x1f2, nsector);  // number of sectors
   outb(0x1f3, sector & 0xff);
   outb(0x1f4, (sector >> 8) & 0xff);
   outb(0x1f5, (sector >> 16) & 0xff);
   outb(0x1f6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
   if(b->flags & B_DIRTY){
     outb(0x1f7, write_cmd);
-    outsl(0x1f0, b->data, BSIZE/4);
+    for(r = b; r; r = r->rnext)
+      outsl(0x1f0, r->data, BSIZE/4);
   } else {
     outb(0x1f7, read_cmd);
   }
@@ -103,7 +119,7 @@ idestart(struct buf *b)
 void
 ideintr(void)
 {
-  struct buf *b;
+  struct buf *b, *r;
 
   // First queued buffer is the active request.
   acquire(&idelock);
@@ -116,12 +132,15 @@ ideintr(void)
 
   // Read data if needed.
   if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
-    insl(0x1f0, b->data, BSIZE/4);
-
-  // Wake process waiting for this buf.
-  b->flags |= B_VALID;
-  b->flags &= ~B_DIRTY;
-  wakeup(b);
+    for(r = b; r; r = r->rnext)
+      insl(0x1f0, r->data, BSIZE/4);
+
+  // Wake processes waiting for the bufs of this run.
+  for(r = b; r; r = r->rnext){
+    r->flags |= B_VALID;
+    r->flags &= ~B_DIRTY;
+    wakeup(r);
+  }
 
   // Start disk on next buf in queue.
   if(idequeue != 0)
@@ -134,15 +153,21 @@ ideintr(void)
 // Sync buf with disk.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
+// The bufs chained through b->rnext (consecutive blocks, same
+// device and direction) are transferred with the same command.
 void
 iderw(struct buf *b)
 {
-  struct buf **pp;
-
-  if(!holdingsleep(&b->lock))
-    panic("iderw: buf not locked");
-  if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("iderw: nothing to do");
+  struct buf **pp, *r;
+
+  for(r = b; r; r = r->rnext){
+    if(!holdingsleep(&r->lock))
+      panic("iderw: buf not locked");
+    if((r->flags & (B_VALID|B_DIRTY)) == B_VALID)
+      panic("iderw: nothing to do");
+    if((r->flags & B_DIRTY) != (b->flags & B_DIRTY))
+      panic("iderw: mixed run");
+  }
   if(b->dev != 0 && !havedisk1)
     panic("iderw: ide disk 1 not present");
 
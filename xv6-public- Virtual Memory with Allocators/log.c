@@ -4,6 +4,7 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
+#include "stat.h"
 #include "buf.h"
 
 // Simple logging that allows concurrent FS system calls.
@@ -28,6 +29,14 @@
 //   block C
 //   ...
 // Log appends are synchronous.
+//
+// Installation is deferred. A commit appends the transaction's
+// blocks after those of earlier, still uninstalled transactions
+// and rewrites the header; the blocks stay pinned (B_DIRTY) in
+// the buffer cache. Only when the log cannot hold another
+// transaction does commit install everything and empty the log
+// (a checkpoint). A block logged by several transactions is
+// installed once, from its newest copy.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -42,6 +51,7 @@ struct log {
   int size;
   int outstanding; // how many FS sys calls are executing.
   int committing;  // in commit(), please wait.
+  int committed;   // lh.block[0..committed-1] are committed, not installed
   int dev;
   struct logheader lh;
 };
@@ -65,20 +75,63 @@ initlog(int dev)
   recover_from_log();
 }
 
-// Copy committed blocks from log to their home location
+// Is block[tail] logged again by a later slot of the log?
+static int
+superseded(int tail)
+{
+  int i;
+
+  for(i = tail+1; i < log.lh.n; i++)
+    if(log.lh.block[i] == log.lh.block[tail])
+      return 1;
+  return 0;
+}
+
+// Copy committed blocks to their home location.
+// On recovery the data comes from the log; otherwise the
+// newest version is still pinned in the buffer cache.
 static void
-install_trans(void)
+install_trans(int recovering)
 {
-  int tail;
-
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    brelse(lbuf);
-    brelse(dbuf);
+  struct buf *dbuf[BRUNMAX];
+  struct buf *lbuf;
+  char skip[LOGSIZE];
+  int tail, i, n, b;
+
+  for(tail = 0; tail < log.lh.n; tail++){
+    if((skip[tail] = superseded(tail)) != 0)
+      fsstats.absorbed++;
+  }
+
+  n = 0;
+  for(b = 0; b < FSSIZE; b = log.lh.block[i] + 1){
+    // Install in block order so that runs of neighbouring
+    // blocks go to the disk together.
+    i = -1;
+    for(tail = 0; tail < log.lh.n; tail++){
+      if(log.lh.block[tail] < b || skip[tail])
+        continue;
+      if(i < 0 || log.lh.block[tail] < log.lh.block[i])
+        i = tail;
+    }
+    if(i < 0)
+      break;
+    dbuf[n] = bread(log.dev, log.lh.block[i]);  // read dst
+    if(recovering){
+      lbuf = bread(log.dev, log.start+i+1);  // read log block
+      memmove(dbuf[n]->data, lbuf->data, BSIZE);  // copy block to dst
+      brelse(lbuf);
+    }
+    fsstats.installs++;
+    if(++n == BRUNMAX){
+      bwritev(dbuf, n);  // write dst to disk
+      while(n > 0)
+        brelse(dbuf[--n]);
+    }
   }
+  bwritev(dbuf, n);
+  while(n > 0)
+    brelse(dbuf[--n]);
 }
 
 // Read the log header from disk into the in-memory log header
@@ -116,8 +169,9 @@ static void
 recover_from_log(void)
 {
   read_head();
-  install_trans(); // if committed, copy from log to disk
+  install_trans(1); // if committed, copy from log to disk
   log.lh.n = 0;
+  log.committed = 0;
   write_head(); // clear the log
 }
 
@@ -173,37 +227,59 @@ end_op(void)
   }
 }
 
-// Copy modified blocks from cache to log.
+// Copy the current transaction's modified blocks from cache
+// to the log, each run of log blocks in one disk transfer.
 static void
 write_log(void)
 {
-  int tail;
+  struct buf *to[BRUNMAX];
+  struct buf *from;
+  int tail, n;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+  n = 0;
+  for (tail = log.committed; tail < log.lh.n; tail++) {
+    to[n] = bget(log.dev, log.start+tail+1); // log block, overwritten
+    from = bread(log.dev, log.lh.block[tail]); // cache block
+    memmove(to[n]->data, from->data, BSIZE);
     brelse(from);
-    brelse(to);
+    if(++n == BRUNMAX || tail == log.lh.n-1){
+      bwritev(to, n);  // write the log
+      fsstats.logwrites += n;
+      while(n > 0)
+        brelse(to[--n]);
+    }
   }
 }
 
+// Install all committed transactions and empty the log.
+static void
+checkpoint(void)
+{
+  install_trans(0); // Now install writes to home locations
+  log.lh.n = 0;
+  log.committed = 0;
+  write_head();    // Erase the transactions from the log
+  fsstats.checkpoints++;
+}
+
 static void
 commit()
 {
-  if (log.lh.n > 0) {
+  if (log.lh.n > log.committed) {
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    log.committed = log.lh.n;
+    fsstats.commits++;
   }
+  // Leave room for at least one more operation.
+  if (log.lh.n + MAXOPBLOCKS > LOGSIZE)
+    checkpoint();
 }
 
 // Caller has modified b->data and is done with the buffer.
 // Record the block number and pin in the cache with B_DIRTY.
-// commit()/write_log() will do the disk write.
+// commit()/write_log() will do the disk write; the pin stays
+// until the next checkpoint installs the block.
 //
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bread(...)
@@ -221,7 +297,7 @@ log_write(struct buf *b)
     panic("log_write outside of trans");
 
   acquire(&log.lock);
-  for (i = 0; i < log.lh.n; i++) {
+  for (i = log.committed; i < log.lh.n; i++) {
     if (log.lh.block[i] == b->blockno)   // log absorbtion
       break;
   }
@@ -5,6 +5,95 @@
 
 char buf[512];
 
+void
+fail(char *msg)
+{
+  printf(1, "test: %s\n", msg);
+  exit();
+}
+
+int
+same(char *a, char *b, int n)
+{
+  while(n-- > 0)
+    if(*a++ != *b++)
+      return 0;
+  return 1;
+}
+
+// lseek() from each whence, and pread()/pwrite(), which must
+// leave the file offset where it was.
+void
+whencetest(void)
+{
+  int fd;
+
+  if((fd = open("lseek.txt", O_RDWR)) < 0)
+    fail("cannot open lseek.txt");
+  if(lseek(fd, 0, SEEK_END) != 15)
+    fail("SEEK_END gave the wrong offset");
+  if(lseek(fd, -5, SEEK_END) != 10 || read(fd, buf, 5) != 5 ||
+     !same(buf, "World", 5))
+    fail("read after SEEK_END went wrong");
+  if(lseek(fd, 1, SEEK_SET) != 1 || lseek(fd, 2, SEEK_CUR) != 3)
+    fail("SEEK_SET or SEEK_CUR gave the wrong offset");
+  if(lseek(fd, -1, SEEK_SET) >= 0 || lseek(fd, 0, 3) >= 0)
+    fail("bad lseek succeeded");
+
+  if(pread(fd, buf, 5, 10) != 5 || !same(buf, "World", 5))
+    fail("pread read the wrong data");
+  if(pwrite(fd, "J", 1, 0) != 1)
+    fail("pwrite failed");
+  if(lseek(fd, 0, SEEK_CUR) != 3)
+    fail("pread or pwrite moved the offset");
+  if(read(fd, buf, 2) != 2 || !same(buf, "lo", 2))
+    fail("read after pread went wrong");
+  if(pread(fd, buf, 5, 0) != 5 || !same(buf, "Jello", 5))
+    fail("pwrite wrote the wrong data");
+  if(pread(fd, buf, 5, 15) != 0 || pread(fd, buf, 5, -1) >= 0)
+    fail("pread past the end went wrong");
+  close(fd);
+}
+
+// NCHILD processes pread() random blocks of one shared file,
+// each block stamped with its number. With lseek() and read()
+// they would race on the shared offset.
+void
+sharedtest(void)
+{
+  enum { NCHILD = 4, NBLK = 64 };
+  int fd, i, pi, b;
+  uint seed;
+
+  if((fd = open("lseek.dat", O_CREATE | O_RDWR)) < 0)
+    fail("cannot create lseek.dat");
+  for(b = 0; b < NBLK; b++){
+    memset(buf, b, sizeof(buf));
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf))
+      fail("write lseek.dat failed");
+  }
+
+  for(pi = 0; pi < NCHILD; pi++){
+    if(fork() == 0){
+      seed = pi + 1;
+      for(i = 0; i < 500; i++){
+        seed = seed * 1103515245 + 12345;
+        b = (seed >> 8) % NBLK;
+        if(pread(fd, buf, sizeof(buf), b * sizeof(buf)) != sizeof(buf) ||
+           buf[0] != b || buf[sizeof(buf) - 1] != b)
+          fail("pread of a shared file got the wrong block");
+      }
+      exit();
+    }
+  }
+  for(pi = 0; pi < NCHILD; pi++)
+    wait();
+  if(lseek(fd, 0, SEEK_CUR) != NBLK * sizeof(buf))
+    fail("children moved the shared offset");
+  close(fd);
+  unlink("lseek.dat");
+}
+
 int
 main(void)
 {
@@ -27,7 +116,7 @@ main(void)
 
   // Move file pointer 5 positions forward (creating a hole)
   printf(1, "Seeking 5 positions forward...\n");
-  if(lseek(fd, 5) < 0){
+  if(lseek(fd, 5, SEEK_CUR) != 10){
     printf(1, "test: lseek error\n");
     close(fd);
     exit();
@@ -68,6 +157,12 @@ main(void)
   printf(1, "\n");
 
   close(fd);
+
+  printf(1, "Testing lseek whence, pread and pwrite...\n");
+  whencetest();
+  printf(1, "Testing pread from several processes...\n");
+  sharedtest();
+  unlink("lseek.txt");
   printf(1, "Test completed successfully!\n");
   exit();
 }
\ No newline at end of file
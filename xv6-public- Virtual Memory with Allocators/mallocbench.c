@@ -0,0 +1,110 @@
+// malloc() and free() microbenchmarks. Each workload prints the
+// ticks it took and how far it grew the heap.
+//
+//   mallocbench pairs [rounds]   malloc and free one 40-byte block
+//   mallocbench churn [rounds]   replace random blocks of a live
+//                                set with new ones of 0-200 bytes
+//   mallocbench mixed [rounds]   as churn, one in eight of up to 20KB
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NLIVE 1024
+
+char *live[NLIVE];
+uint seed = 1;
+char *brk0;
+int t0;
+
+uint
+rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+void
+start(char *name)
+{
+  printf(1, "%s: ", name);
+  brk0 = sbrk(0);
+  t0 = uptime();
+}
+
+void
+stop(void)
+{
+  int i;
+
+  printf(1, "%d ticks, heap grew %d KB\n", uptime() - t0, (sbrk(0) - brk0) / 1024);
+  for(i = 0; i < NLIVE; i++){
+    free(live[i]);
+    live[i] = 0;
+  }
+}
+
+// Replace a random member of the live set with a new block of
+// size(), 10000 times per round.
+void
+churn(int rounds, uint (*size)(void))
+{
+  int i, k;
+  uint n;
+
+  for(i = 0; i < rounds * 10000; i++){
+    k = rand() % NLIVE;
+    free(live[k]);
+    n = size();
+    if((live[k] = malloc(n)) == 0){
+      printf(1, "mallocbench: malloc(%d) failed\n", n);
+      exit();
+    }
+    if(n > 0)
+      live[k][0] = live[k][n-1] = k;
+  }
+}
+
+uint
+smallsize(void)
+{
+  return rand() % 200;
+}
+
+uint
+mixedsize(void)
+{
+  return rand() % 8 ? rand() % 1000 : rand() % 20000;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds, i;
+  char *p;
+
+  if(argc < 2){
+    printf(2, "usage: mallocbench pairs|churn|mixed [rounds]\n");
+    exit();
+  }
+  rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+  if(strcmp(argv[1], "pairs") == 0){
+    start("pairs");
+    for(i = 0; i < rounds * 100000; i++){
+      p = malloc(40);
+      free(p);
+    }
+    stop();
+  } else if(strcmp(argv[1], "churn") == 0){
+    start("churn");
+    churn(rounds, smallsize);
+    stop();
+  } else if(strcmp(argv[1], "mixed") == 0){
+    start("mixed");
+    churn(rounds, mixedsize);
+    stop();
+  } else
+    printf(2, "mallocbench: unknown workload %s\n", argv[1]);
+  exit();
+}
@@ -11,6 +11,7 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
+#include "stat.h"
 #include "buf.h"
 
 extern uchar _binary_fs_img_start[], _binary_fs_img_size[];
@@ -35,26 +36,33 @@ ideintr(void)
 // Sync buf with disk.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
+// Bufs chained through b->rnext are synced the same way.
 void
 iderw(struct buf *b)
 {
   uchar *p;
 
-  if(!holdingsleep(&b->lock))
-    panic("iderw: buf not locked");
-  if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("iderw: nothing to do");
-  if(b->dev != 1)
-    panic("iderw: request not for disk 1");
-  if(b->blockno >= disksize)
-    panic("iderw: block out of range");
-
-  p = memdisk + b->blockno*BSIZE;
-
-  if(b->flags & B_DIRTY){
-    b->flags &= ~B_DIRTY;
-    memmove(p, b->data, BSIZE);
-  } else
-    memmove(b->data, p, BSIZE);
-  b->flags |= B_VALID;
+  fsstats.diskcmds++;
+  for(; b; b = b->rnext){
+    if(!holdingsleep(&b->lock))
+      panic("iderw: buf not locked");
+    if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
+      panic("iderw: nothing to do");
+    if(b->dev != 1)
+      panic("iderw: request not for disk 1");
+    if(b->blockno >= disksize)
+      panic("iderw: block out of range");
+
+    p = memdisk + b->blockno*BSIZE;
+
+    if(b->flags & B_DIRTY){
+      b->flags &= ~B_DIRTY;
+      memmove(p, b->data, BSIZE);
+      fsstats.diskwrites++;
+    } else {
+      memmove(b->data, p, BSIZE);
+      fsstats.diskreads++;
+    }
+    b->flags |= B_VALID;
+  }
 }
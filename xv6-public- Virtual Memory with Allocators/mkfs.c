@@ -15,14 +15,14 @@
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
 #endif
 
-#define NINODES 200
+#define NINODES 6000
 
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
 
 int nbitmap = FSSIZE/(BSIZE*8) + 1;
 int ninodeblocks = NINODES / IPB + 1;
-int nlog = LOGSIZE;
+int nlog = LOGSIZE + 1;  // header block + LOGSIZE data blocks
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
@@ -38,8 +38,9 @@ void wsect(uint, void*);
 void winode(uint, struct dinode*);
 void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
-uint ialloc(ushort type);
+uint ialloc(ushort type, uchar flags);
 void iappend(uint inum, void *p, int n);
+void wdir(uint inum, struct dirent *de, int n);
 
 // convert to intel byte order
 ushort
@@ -67,11 +68,10 @@ xint(uint x)
 int
 main(int argc, char *argv[])
 {
-  int i, cc, fd;
-  uint rootino, inum, off;
-  struct dirent de;
+  int i, cc, fd, nde;
+  uint rootino, inum;
+  struct dirent *de;
   char buf[BSIZE];
-  struct dinode din;
 
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
@@ -90,10 +90,13 @@ main(int argc, char *argv[])
     exit(1);
   }
 
-  // 1 fs block = 1 disk sector
+  // 1 fs block = BSIZE/512 disk sectors
   nmeta = 2 + nlog + ninodeblocks + nbitmap;
   nblocks = FSSIZE - nmeta;
 
+  sb.magic = xint(FSMAGIC);
+  sb.version = xint(FSVERSION);
+  sb.bsize = xint(BSIZE);
   sb.size = xint(FSSIZE);
   sb.nblocks = xint(nblocks);
   sb.ninodes = xint(NINODES);
@@ -114,18 +117,16 @@ main(int argc, char *argv[])
   memmove(buf, &sb, sizeof(sb));
   wsect(1, buf);
 
-  rootino = ialloc(T_DIR);
+  rootino = ialloc(T_DIR, 0);
   assert(rootino == ROOTINO);
 
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, ".");
-  iappend(rootino, &de, sizeof(de));
-
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, "..");
-  iappend(rootino, &de, sizeof(de));
+  // The root directory's entries, written out once all are known.
+  de = calloc(argc, sizeof(struct dirent));
+  de[0].inum = xshort(rootino);
+  strcpy(de[0].name, ".");
+  de[1].inum = xshort(rootino);
+  strcpy(de[1].name, "..");
+  nde = 2;
 
   for(i = 2; i < argc; i++){
     assert(index(argv[i], '/') == 0);
@@ -142,12 +143,13 @@ main(int argc, char *argv[])
     if(argv[i][0] == '_')
       ++argv[i];
 
-    inum = ialloc(T_FILE);
+    // Installed files are written once, contiguously, so
+    // each fits in a single extent.
+    inum = ialloc(T_FILE, I_EXTENT);
 
-    bzero(&de, sizeof(de));
-    de.inum = xshort(inum);
-    strncpy(de.name, argv[i], DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    de[nde].inum = xshort(inum);
+    strncpy(de[nde].name, argv[i], DIRSIZ);
+    nde++;
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -155,12 +157,7 @@ main(int argc, char *argv[])
     close(fd);
   }
 
-  // fix size of root inode dir
-  rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
-  winode(rootino, &din);
+  wdir(rootino, de, nde);
 
   balloc(freeblock);
 
@@ -221,13 +218,14 @@ rsect(uint sec, void *buf)
 }
 
 uint
-ialloc(ushort type)
+ialloc(ushort type, uchar flags)
 {
   uint inum = freeinode++;
   struct dinode din;
 
   bzero(&din, sizeof(din));
-  din.type = xshort(type);
+  din.type = type;
+  din.flags = flags;
   din.nlink = xshort(1);
   din.size = xint(0);
   winode(inum, &din);
@@ -252,6 +250,97 @@ balloc(int used)
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Must match dirhash() in fs.c.
+uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = (h ^ (uchar)name[i]) * 16777619;
+  return h;
+}
+
+// Write the n entries de[] (starting with "." and "..") into
+// the empty directory inum. Up to a block's worth make a plain
+// directory; more make a hashed one, with the fewest buckets
+// that hold every name in its own bucket.
+void
+wdir(uint inum, struct dirent *de, int n)
+{
+  struct dinode din;
+  struct dirent *blk;
+  struct dirhdr hdr;
+  uint level, nb, b, k;
+  int i;
+
+  if(n <= DPB){
+    iappend(inum, de, n * sizeof(struct dirent));
+    // fix size of dir
+    rinode(inum, &din);
+    din.size = xint(BSIZE);
+    winode(inum, &din);
+    return;
+  }
+
+  for(level = 1; ; level++){
+    nb = 1 << level;
+    blk = calloc(nb * DPB, sizeof(struct dirent));
+    blk[0] = de[0];
+    blk[1] = de[1];
+    for(i = 2; i < n; i++){
+      b = dirhash(de[i].name) & (nb - 1);
+      for(k = b == 0 ? 3 : 0; k < DPB && blk[b*DPB + k].inum != 0; k++)
+        ;
+      if(k == DPB)
+        break;
+      blk[b*DPB + k] = de[i];
+    }
+    if(i == n)
+      break;
+    free(blk);
+  }
+
+  assert(sizeof(hdr) == sizeof(struct dirent));
+  bzero(&hdr, sizeof(hdr));
+  hdr.level = xshort(level);
+  hdr.nent = xint(n - 2);
+  memmove(&blk[2], &hdr, sizeof(hdr));
+  iappend(inum, blk, nb * BSIZE);
+  free(blk);
+
+  rinode(inum, &din);
+  din.flags |= I_HASHDIR;
+  winode(inum, &din);
+}
+
+// Return the disk block of file block fbn of the extent-mapped
+// inode din, appending a new block if fbn is just past the end.
+uint
+eappend(struct dinode *din, uint fbn)
+{
+  struct extent *e = (struct extent*)din->addrs;
+  uint i, base;
+
+  base = 0;
+  for(i = 0; i < NEXTENT && xint(e[i].len) > 0; i++){
+    if(fbn < base + xint(e[i].len))
+      return xint(e[i].start) + fbn - base;
+    base += xint(e[i].len);
+  }
+  assert(fbn == base);
+  if(i > 0 && xint(e[i-1].start) + xint(e[i-1].len) == freeblock){
+    e[i-1].len = xint(xint(e[i-1].len) + 1);
+  } else {
+    assert(i < NEXTENT);
+    e[i].start = xint(freeblock);
+    e[i].len = xint(1);
+  }
+  return freeblock++;
+}
+
 void
 iappend(uint inum, void *xp, int n)
 {
@@ -268,7 +357,9 @@ iappend(uint inum, void *xp, int n)
   while(n > 0){
     fbn = off / BSIZE;
     assert(fbn < MAXFILE);
-    if(fbn < NDIRECT){
+    if(din.flags & I_EXTENT){
+      x = eappend(&din, fbn);
+    } else if(fbn < NDIRECT){
       if(xint(din.addrs[fbn]) == 0){
         din.addrs[fbn] = xint(freeblock++);
       }
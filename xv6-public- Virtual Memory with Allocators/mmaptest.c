@@ -0,0 +1,175 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define PGSIZE 4096
+#define FILESIZE (2*PGSIZE + 1000)
+
+char buf[FILESIZE];
+
+void
+fail(char *msg)
+{
+  printf(1, "mmaptest: %s\n", msg);
+  exit();
+}
+
+char
+pattern(int i)
+{
+  return 'a' + i % 23;
+}
+
+// Write FILESIZE bytes of pattern() to name.
+void
+mkfile(char *name)
+{
+  int i, fd;
+
+  for(i = 0; i < FILESIZE; i++)
+    buf[i] = pattern(i);
+  if((fd = open(name, O_CREATE | O_RDWR)) < 0 ||
+     write(fd, buf, FILESIZE) != FILESIZE)
+    fail("cannot write test file");
+  close(fd);
+}
+
+void
+anontest(void)
+{
+  char *p;
+  int i;
+
+  printf(1, "anonymous private mapping\n");
+  p = mmap(0, 3*PGSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+  if(p == MAP_FAILED)
+    fail("mmap anonymous failed");
+  for(i = 0; i < 3*PGSIZE; i++)
+    if(p[i] != 0)
+      fail("anonymous memory is not zero");
+  for(i = 0; i < 3*PGSIZE; i++)
+    p[i] = i;
+  for(i = 0; i < 3*PGSIZE; i++)
+    if(p[i] != (char)i)
+      fail("anonymous memory lost a store");
+  // Cut the middle page out, leaving two regions.
+  if(munmap(p + PGSIZE, PGSIZE) < 0)
+    fail("munmap of the middle page failed");
+  if(p[0] != 0 || p[2*PGSIZE + 1] != 1)
+    fail("pages around the hole changed");
+  if(munmap(p, 3*PGSIZE) < 0)
+    fail("munmap failed");
+}
+
+void
+privatetest(void)
+{
+  char *p;
+  int i, fd;
+
+  printf(1, "file private mapping\n");
+  mkfile("mmap.dat");
+  if((fd = open("mmap.dat", O_RDONLY)) < 0)
+    fail("cannot open mmap.dat");
+  p = mmap(0, FILESIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if(p == MAP_FAILED)
+    fail("mmap private failed");
+  close(fd);  // the mapping keeps the file open
+  for(i = 0; i < FILESIZE; i++)
+    if(p[i] != pattern(i))
+      fail("private mapping has the wrong data");
+  for(i = FILESIZE; i < 3*PGSIZE; i++)
+    if(p[i] != 0)
+      fail("private mapping past the end of the file is not zero");
+  p[0] = 'X';
+  if(munmap(p, FILESIZE) < 0)
+    fail("munmap failed");
+
+  if((fd = open("mmap.dat", O_RDONLY)) < 0 || read(fd, buf, 1) != 1)
+    fail("cannot read mmap.dat");
+  if(buf[0] != pattern(0))
+    fail("store to a private mapping reached the file");
+
+  // A page offset, and a shared writable mapping of a read-only fd.
+  p = mmap(0, PGSIZE, PROT_READ, MAP_PRIVATE, fd, PGSIZE);
+  if(p == MAP_FAILED || p[0] != pattern(PGSIZE))
+    fail("mmap at an offset went wrong");
+  munmap(p, PGSIZE);
+  if(mmap(0, PGSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) != MAP_FAILED)
+    fail("writable shared mapping of a read-only file succeeded");
+  close(fd);
+}
+
+void
+sharedtest(void)
+{
+  char *p;
+  int fd, pid;
+
+  printf(1, "file shared mapping\n");
+  mkfile("mmap.dat");
+  if((fd = open("mmap.dat", O_RDWR)) < 0)
+    fail("cannot open mmap.dat");
+  p = mmap(0, FILESIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED)
+    fail("mmap shared failed");
+  p[1] = 'Y';
+  p[FILESIZE - 1] = 'Z';
+  p[FILESIZE] = 'W';  // past the end: must not grow the file
+  if(munmap(p, FILESIZE) < 0)
+    fail("munmap failed");
+  if(pread(fd, buf, FILESIZE + 10, 0) != FILESIZE)
+    fail("munmap changed the file's size");
+  if(buf[1] != 'Y' || buf[FILESIZE - 1] != 'Z' || buf[2] != pattern(2))
+    fail("munmap did not write back a shared mapping");
+
+  // A child's stores are written back when it exits.
+  p = mmap(0, FILESIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED)
+    fail("mmap shared failed");
+  if(p[1] != 'Y')
+    fail("shared mapping missed an earlier store");
+  if((pid = fork()) < 0)
+    fail("fork failed");
+  if(pid == 0){
+    if(p[1] != 'Y')
+      fail("child does not see the parent's mapping");
+    p[PGSIZE] = 'C';
+    exit();
+  }
+  wait();
+  munmap(p, FILESIZE);
+  if(pread(fd, buf, 1, PGSIZE) != 1 || buf[0] != 'C')
+    fail("exit did not write back a shared mapping");
+
+  // A mapping can be a write() buffer.
+  p = mmap(0, FILESIZE, PROT_READ, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED)
+    fail("mmap shared failed");
+  close(fd);
+  if((fd = open("mmap.cpy", O_CREATE | O_RDWR)) < 0 ||
+     write(fd, p, FILESIZE) != FILESIZE)
+    fail("write from a mapping failed");
+  if(pread(fd, buf, 3, PGSIZE - 1) != 3 || buf[1] != 'C')
+    fail("write from a mapping wrote the wrong data");
+  close(fd);
+  munmap(p, FILESIZE);
+  unlink("mmap.cpy");
+  unlink("mmap.dat");
+}
+
+int
+main(void)
+{
+  char *top;
+
+  top = sbrk(0);
+  anontest();
+  privatetest();
+  sharedtest();
+  if(sbrk(0) != top)
+    fail("mmap moved the heap");
+  printf(1, "mmaptest ok\n");
+  exit();
+}
@@ -2,6 +2,7 @@
 // x86 memory management unit (MMU).
 
 // Eflags register
+#define FL_TF           0x00000100      // Trap Flag
 #define FL_IF           0x00000200      // Interrupt Enable
 
 // Control Register flags
@@ -94,6 +95,7 @@ struct segdesc {
 #define PTE_P           0x001   // Present
 #define PTE_W           0x002   // Writeable
 #define PTE_U           0x004   // User
+#define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size
 
 // Address in page table or page directory entry
@@ -4,11 +4,20 @@
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE       50  // fewest in-memory inodes; see iinit()
+#define NIHASH      512  // inode cache hash buckets
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
+#define NSYSARG       6  // max system call arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE  250000  // size of file system in blocks   // Changed from 1000 to 250000
+#define LOGSIZE      (MAXOPBLOCKS*6)  // max data blocks in on-disk log
+#define NBUF         (MAXOPBLOCKS*10) // size of disk block cache
+#define NBMAPC        8  // block map runs cached per inode
+#define NRECLAIM     16  // unlinked inodes waiting for the reclaim thread
+#define NDCACHE     256  // directory entry cache slots
+#define MAXSYMLINKS  10  // symbolic links followed in one path lookup
+#define NVMA         16  // mmap()ed regions per process
+#define NSEG          4  // loadable program segments per process
+#define PIPEMAXPAGES 16  // most pages in one pipe's buffer
+#define FSSIZE   31250  // size of file system in blocks
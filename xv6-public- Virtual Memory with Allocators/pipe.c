@@ -7,12 +7,16 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "fcntl.h"
 
-#define PIPESIZE 512
-
+// A pipe's data lives in a ring of npage separately allocated
+// pages; npage is a power of two so that nread and nwrite can run
+// freely and wrap around a uint.
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *page[PIPEMAXPAGES];
+  int npage;      // pages in the ring
+  uint size;      // npage*PGSIZE
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
@@ -30,6 +34,11 @@ pipealloc(struct file **f0, struct file **f1)
     goto bad;
   if((p = (struct pipe*)kalloc()) == 0)
     goto bad;
+  memset(p->page, 0, sizeof(p->page));
+  if((p->page[0] = kalloc()) == 0)
+    goto bad;
+  p->npage = 1;
+  p->size = PGSIZE;
   p->readopen = 1;
   p->writeopen = 1;
   p->nwrite = 0;
@@ -59,6 +68,8 @@ pipealloc(struct file **f0, struct file **f1)
 void
 pipeclose(struct pipe *p, int writable)
 {
+  int i;
+
   acquire(&p->lock);
   if(writable){
     p->writeopen = 0;
@@ -69,11 +80,74 @@ pipeclose(struct pipe *p, int writable)
   }
   if(p->readopen == 0 && p->writeopen == 0){
     release(&p->lock);
+    for(i = 0; i < p->npage; i++)
+      kfree(p->page[i]);
     kfree((char*)p);
   } else
     release(&p->lock);
 }
 
+// Copy n bytes between addr and p's ring starting at ring
+// offset off, into the ring if in is set. One memmove per page,
+// so a copy that fits in a page takes at most two, one on each
+// side of the wrap.
+static void
+ringcopy(struct pipe *p, uint off, char *addr, uint n, int in)
+{
+  uint m;
+  char *r;
+
+  for(; n > 0; n -= m, off += m, addr += m){
+    off %= p->size;
+    m = PGSIZE - off%PGSIZE;
+    if(m > n)
+      m = n;
+    r = p->page[off/PGSIZE] + off%PGSIZE;
+    if(in)
+      memmove(r, addr, m);
+    else
+      memmove(addr, r, m);
+  }
+}
+
+// Copy as much of addr[0..n) into p as there is room for, and
+// wake readers if p was empty. Caller must hold p->lock.
+static int
+putbytes(struct pipe *p, char *addr, int n)
+{
+  uint room;
+
+  room = p->size - (p->nwrite - p->nread);
+  if(n > room)
+    n = room;
+  if(n <= 0)
+    return 0;
+  ringcopy(p, p->nwrite, addr, n, 1);
+  if(p->nwrite == p->nread)
+    wakeup(&p->nread);
+  p->nwrite += n;
+  return n;
+}
+
+// Copy up to n bytes out of p into addr, and wake writers if p
+// was full. Caller must hold p->lock.
+static int
+getbytes(struct pipe *p, char *addr, int n)
+{
+  uint len;
+
+  len = p->nwrite - p->nread;
+  if(n > len)
+    n = len;
+  if(n <= 0)
+    return 0;
+  ringcopy(p, p->nread, addr, n, 0);
+  if(len == p->size)
+    wakeup(&p->nwrite);
+  p->nread += n;
+  return n;
+}
+
 //PAGEBREAK: 40
 int
 pipewrite(struct pipe *p, char *addr, int n)
@@ -81,26 +155,58 @@ pipewrite(struct pipe *p, char *addr, int n)
   int i;
 
   acquire(&p->lock);
-  for(i = 0; i < n; i++){
-    while(p->nwrite == p->nread + PIPESIZE){  //DOC: pipewrite-full
+  for(i = 0; i < n; i += putbytes(p, addr + i, n - i)){
+    while(p->nwrite == p->nread + p->size){  //DOC: pipewrite-full
       if(p->readopen == 0 || myproc()->killed){
         release(&p->lock);
         return -1;
       }
-      wakeup(&p->nread);
       sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
     }
-    p->data[p->nwrite++ % PIPESIZE] = addr[i];
   }
-  wakeup(&p->nread);  //DOC: pipewrite-wakeup1
   release(&p->lock);
   return n;
 }
 
+// Copy as much of addr[0..n) into p as there is room for,
+// without sleeping, for sendfile(). Returns the number of bytes
+// copied, or -1 if p has no reader.
+int
+pipeput(struct pipe *p, char *addr, int n)
+{
+  int r;
+
+  acquire(&p->lock);
+  if(p->readopen == 0){
+    release(&p->lock);
+    return -1;
+  }
+  r = putbytes(p, addr, n);
+  release(&p->lock);
+  return r;
+}
+
+// Sleep until p has room. Returns -1 if p has no reader or the
+// process has been killed.
+int
+pipewait(struct pipe *p)
+{
+  acquire(&p->lock);
+  while(p->nwrite == p->nread + p->size){
+    if(p->readopen == 0 || myproc()->killed){
+      release(&p->lock);
+      return -1;
+    }
+    sleep(&p->nwrite, &p->lock);
+  }
+  release(&p->lock);
+  return 0;
+}
+
 int
 piperead(struct pipe *p, char *addr, int n)
 {
-  int i;
+  int r;
 
   acquire(&p->lock);
   while(p->nread == p->nwrite && p->writeopen){  //DOC: pipe-empty
@@ -110,12 +216,92 @@ piperead(struct pipe *p, char *addr, int n)
     }
     sleep(&p->nread, &p->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(p->nread == p->nwrite)
+  r = getbytes(p, addr, n);  //DOC: piperead-copy
+  release(&p->lock);
+  return r;
+}
+
+// Read into the niov buffers of iov in turn. Sleeps, as piperead()
+// does, only until p has some bytes, then takes what is there.
+int
+pipereadv(struct pipe *p, struct iovec *iov, int niov)
+{
+  int i, r, tot;
+
+  acquire(&p->lock);
+  while(p->nread == p->nwrite && p->writeopen){
+    if(myproc()->killed){
+      release(&p->lock);
+      return -1;
+    }
+    sleep(&p->nread, &p->lock);
+  }
+  tot = 0;
+  for(i = 0; i < niov; i++){
+    r = getbytes(p, iov[i].base, iov[i].len);
+    tot += r;
+    if(r < iov[i].len)
       break;
-    addr[i] = p->data[p->nread++ % PIPESIZE];
   }
-  wakeup(&p->nwrite);  //DOC: piperead-wakeup
   release(&p->lock);
-  return i;
+  return tot;
+}
+
+// Give p a ring of at least n bytes, rounded up to a power of two
+// pages, keeping what it holds. Returns the new size, or -1 if n
+// is too big or too small for the data already in p.
+int
+piperesize(struct pipe *p, int n)
+{
+  char *page[PIPEMAXPAGES], *old;
+  int i, npage, len;
+
+  if(n <= 0)
+    return -1;
+  for(npage = 1; npage*PGSIZE < n; npage *= 2)
+    if(npage == PIPEMAXPAGES)
+      return -1;
+  for(i = 0; i < npage; i++){
+    if((page[i] = kalloc()) == 0){
+      while(--i >= 0)
+        kfree(page[i]);
+      return -1;
+    }
+  }
+
+  acquire(&p->lock);
+  len = p->nwrite - p->nread;
+  if(len > npage*PGSIZE){
+    release(&p->lock);
+    for(i = 0; i < npage; i++)
+      kfree(page[i]);
+    return -1;
+  }
+  // Move the data to the start of the new ring, a page at a time.
+  for(i = 0; i*PGSIZE < len; i++)
+    ringcopy(p, p->nread + i*PGSIZE, page[i],
+             len - i*PGSIZE < PGSIZE ? len - i*PGSIZE : PGSIZE, 0);
+  for(i = 0; i < PIPEMAXPAGES; i++){
+    old = p->page[i];
+    p->page[i] = i < npage ? page[i] : 0;
+    page[i] = old;
+  }
+  if(len == p->size)
+    wakeup(&p->nwrite);
+  i = p->npage;
+  p->npage = npage;
+  p->size = npage*PGSIZE;
+  p->nread = 0;
+  p->nwrite = len;
+  release(&p->lock);
+  while(--i >= 0)
+    kfree(page[i]);
+  return npage*PGSIZE;
+}
+
+// The size of p's ring.
+int
+pipesize(struct pipe *p)
+{
+  return p->size;
 }
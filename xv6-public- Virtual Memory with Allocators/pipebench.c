@@ -0,0 +1,70 @@
+// Pipe throughput: a child writes a number of megabytes into a
+// pipe and the parent reads them back, with 512-byte and 4KB
+// reads and writes, first through the default one-page buffer
+// and then through a 64KB one. Prints the rate in KB/s.
+//
+//   pipebench [megabytes]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+char buf[4096];
+
+void
+run(int mb, int pipesz, int chunk)
+{
+  int p[2], n, t, tot;
+
+  if(pipe(p) < 0){
+    printf(1, "pipebench: pipe failed\n");
+    exit();
+  }
+  if(pipesz > 0 && fcntl(p[1], F_SETPIPE_SZ, pipesz) < 0){
+    printf(1, "pipebench: F_SETPIPE_SZ %d failed\n", pipesz);
+    exit();
+  }
+  pipesz = fcntl(p[1], F_GETPIPE_SZ, 0);
+
+  t = uptime();
+  if(fork() == 0){
+    close(p[0]);
+    for(tot = 0; tot < mb * 1024 * 1024; tot += chunk){
+      if(write(p[1], buf, chunk) != chunk){
+        printf(1, "pipebench: write failed\n");
+        exit();
+      }
+    }
+    exit();
+  }
+  close(p[1]);
+  tot = 0;
+  while((n = read(p[0], buf, chunk)) > 0)
+    tot += n;
+  close(p[0]);
+  wait();
+  t = uptime() - t;
+
+  if(tot != mb * 1024 * 1024){
+    printf(1, "pipebench: read %d bytes, wanted %d\n", tot, mb * 1024 * 1024);
+    exit();
+  }
+  printf(1, "buffer %d, %d-byte chunks: %d ticks", pipesz, chunk, t);
+  if(t > 0)
+    printf(1, ", %d KB/s", mb * 1024 * 100 / t);
+  printf(1, "\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb;
+
+  mb = argc > 1 ? atoi(argv[1]) : 4;
+  run(mb, 0, 512);
+  run(mb, 0, 4096);
+  run(mb, 65536, 512);
+  run(mb, 65536, 4096);
+  exit();
+}
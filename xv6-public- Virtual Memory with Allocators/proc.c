@@ -6,6 +6,7 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "fcntl.h"
 
 struct {
   struct spinlock lock;
@@ -19,6 +20,7 @@ extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void kthreadret(void);
 
 void
 pinit(void)
@@ -153,6 +155,27 @@ userinit(void)
   release(&ptable.lock);
 }
 
+// Create a kernel thread that runs fn(), which must not return.
+// It has no user memory, only the kernel's mappings.
+void
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0 || (p->pgdir = setupkvm()) == 0)
+    panic("kthread");
+
+  // Start at kthreadret, which "returns" to fn, left
+  // where allocproc put trapret.
+  p->context->eip = (uint)kthreadret;
+  *(uint*)(p->context + 1) = (uint)fn;
+  safestrcpy(p->name, name, sizeof(p->name));
+
+  acquire(&ptable.lock);
+  p->state = RUNNABLE;
+  release(&ptable.lock);
+}
+
 // Grow current process's memory by n bytes.
 // Return 0 on success, -1 on failure.
 int
@@ -196,7 +219,19 @@ fork(void)
     np->state = UNUSED;
     return -1;
   }
+  if(vmacopy(np, curproc) < 0){
+    vmaclear(np);
+    freevm(np->pgdir);
+    np->pgdir = 0;
+    kfree(np->kstack);
+    np->kstack = 0;
+    np->state = UNUSED;
+    return -1;
+  }
   np->sz = curproc->sz;
+  np->exe = curproc->exe ? idup(curproc->exe) : 0;
+  memmove(np->seg, curproc->seg, sizeof(np->seg));
+  np->nseg = curproc->nseg;
   np->parent = curproc;
   *np->tf = *curproc->tf;
 
@@ -221,6 +256,80 @@ fork(void)
   return pid;
 }
 
+// Start the program at path, with arguments argv, in a new child
+// process, as fork() then exec() would but without copying this
+// process's memory: execproc() loads the program straight into
+// the child's fresh page table. The child's open files are a copy
+// of this process's, changed by the nact actions in act.
+// Returns the child's pid, or -1.
+int
+spawn(char *path, char **argv, struct spawnact *act, int nact)
+{
+  int i, fd, nfd;
+  struct file *f;
+  struct proc *np;
+  struct proc *curproc = myproc();
+
+  if((np = allocproc()) == 0)
+    return -1;
+  np->pgdir = 0;
+  np->sz = 0;
+  np->exe = 0;
+  np->parent = curproc;
+  *np->tf = *curproc->tf;  // user segments and flags
+  np->tf->eax = 0;
+
+  for(i = 0; i < NOFILE; i++)
+    np->ofile[i] = curproc->ofile[i] ? filedup(curproc->ofile[i]) : 0;
+  np->cwd = idup(curproc->cwd);
+
+  for(i = 0; i < nact; i++){
+    fd = act[i].fd;
+    nfd = act[i].newfd;
+    if(fd < 0 || fd >= NOFILE || np->ofile[fd] == 0)
+      goto bad;
+    if(act[i].op == SPAWN_DUP){
+      if(nfd < 0 || nfd >= NOFILE)
+        goto bad;
+      if(nfd == fd)
+        continue;
+      f = filedup(np->ofile[fd]);
+      if(np->ofile[nfd])
+        fileclose(np->ofile[nfd]);
+      np->ofile[nfd] = f;
+    } else if(act[i].op == SPAWN_CLOSE){
+      fileclose(np->ofile[fd]);
+      np->ofile[fd] = 0;
+    } else
+      goto bad;
+  }
+
+  if(execproc(np, path, argv) < 0)
+    goto bad;
+
+  acquire(&ptable.lock);
+  np->state = RUNNABLE;
+  release(&ptable.lock);
+  return np->pid;
+
+bad:
+  for(i = 0; i < NOFILE; i++){
+    if(np->ofile[i]){
+      fileclose(np->ofile[i]);
+      np->ofile[i] = 0;
+    }
+  }
+  begin_op();
+  iput(np->cwd);
+  end_op();
+  np->cwd = 0;
+  kfree(np->kstack);
+  np->kstack = 0;
+  np->parent = 0;
+  np->state = UNUSED;
+  return -1;
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait() to find out it exited.
@@ -234,6 +343,9 @@ exit(void)
   if(curproc == initproc)
     panic("init exiting");
 
+  // Write back and drop mmap()ed regions.
+  vmaclear(curproc);
+
   // Close all open files.
   for(fd = 0; fd < NOFILE; fd++){
     if(curproc->ofile[fd]){
@@ -244,8 +356,11 @@ exit(void)
 
   begin_op();
   iput(curproc->cwd);
+  if(curproc->exe)
+    iput(curproc->exe);
   end_op();
   curproc->cwd = 0;
+  curproc->exe = 0;
 
   acquire(&ptable.lock);
 
@@ -407,11 +522,21 @@ forkret(void)
     first = 0;
     iinit(ROOTDEV);
     initlog(ROOTDEV);
+    reclaiminit(ROOTDEV);
   }
 
   // Return to "caller", actually trapret (see allocproc).
 }
 
+// A kernel thread's first scheduling by scheduler()
+// will swtch here.  "Return" to the thread's function.
+static void
+kthreadret(void)
+{
+  // Still holding ptable.lock from scheduler.
+  release(&ptable.lock);
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
@@ -34,6 +34,27 @@ struct context {
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A region set up by mmap(). Its pages are faulted in on first
+// use, from the file if there is one.
+struct vma {
+  uint start;                  // First address, 0 if the slot is free
+  uint end;                    // Just past the last page
+  int prot;                    // PROT_ bits
+  int flags;                   // MAP_ bits
+  struct file *f;              // Mapped file, or 0 if anonymous
+  uint off;                    // File offset of start
+};
+
+// A loadable segment of the program a process runs. Its pages are
+// filled in by execfault() when first touched: from the file up to
+// filesz, zeroes past that.
+struct execseg {
+  uint va;                     // First address, page-aligned
+  uint filesz;                 // Bytes in the file
+  uint memsz;                  // Bytes in memory
+  uint off;                    // File offset of va
+};
+
 // Per-process state
 struct proc {
   uint sz;                     // Size of process memory (bytes)
@@ -49,6 +70,12 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  struct vma vma[NVMA];        // mmap()ed regions
+  struct inode *exe;           // Program file, or 0
+  struct execseg seg[NSEG];    // Program segments in exe
+  int nseg;
+  int sysarg[NSYSARG];         // Arguments of the current syscall
+  int nsysarg;                 // Number of them in sysarg
 };
 
 // Process memory is laid out contiguously, low addresses first:
@@ -56,3 +83,5 @@ struct proc {
 //   original data and bss
 //   fixed-size stack
 //   expandable heap
+//   ...
+//   mmap()ed regions, placed down from MMAPTOP
@@ -1,6 +1,7 @@
 // Shell.
 
 #include "types.h"
+#include "stat.h"
 #include "user.h"
 #include "fcntl.h"
 
@@ -12,6 +13,10 @@
 #define BACK  5
 
 #define MAXARGS 10
+#define MAXSTAGE 16  // pipeline processes started by one launch()
+#define NJOB 8       // background jobs
+#define NPATH 16     // remembered command names
+#define NREDIR 4     // redirections on a spawn()ed command
 
 struct cmd {
   int type;
@@ -21,6 +26,7 @@ struct execcmd {
   int type;
   char *argv[MAXARGS];
   char *eargv[MAXARGS];
+  char *path;  // argv[0], once resolve() has found it
 };
 
 struct redircmd {
@@ -49,19 +55,44 @@ struct backcmd {
   struct cmd *cmd;
 };
 
+// A job is the processes started for a command: one, or one per
+// stage of a pipeline. Background jobs come from &.
+struct job {
+  int id;              // 0 if the slot is free
+  int pid[MAXSTAGE];   // 0 once reaped
+  int npid;
+  int nlive;           // processes not yet reaped
+  int done;            // background job finished, not yet reported
+  char line[100];
+};
+
+struct job fg;          // the foreground job
+struct job jobs[NJOB];  // background jobs; jobs[i].id is i+1
+
+// Names of programs resolve() has found, so that each isn't looked
+// up again. cd empties it, as names are relative to the directory.
+char pathcache[NPATH][16];
+int pathnext;
+
+int nospawn;  // -f: fork() for every command, to compare
+
+struct spawnact act[NSPAWNACT];
+int nact;
+
 int fork1(void);  // Fork but panics on failure.
 void panic(char*);
 struct cmd *parsecmd(char*);
+int launch(struct cmd*, int*);
+void resolve(struct cmd*);
 
 // Execute cmd.  Never returns.
 void
 runcmd(struct cmd *cmd)
 {
-  int p[2];
+  int pid[MAXSTAGE], n;
   struct backcmd *bcmd;
   struct execcmd *ecmd;
   struct listcmd *lcmd;
-  struct pipecmd *pcmd;
   struct redircmd *rcmd;
 
   if(cmd == 0)
@@ -98,41 +129,293 @@ runcmd(struct cmd *cmd)
     break;
 
   case PIPE:
+    for(n = launch(cmd, pid); n > 0; n--)
+      wait();
+    break;
+
+  case BACK:
+    bcmd = (struct backcmd*)cmd;
+    if(fork1() == 0)
+      runcmd(bcmd->cmd);
+    break;
+  }
+  exit();
+}
+
+void
+action(int op, int fd, int newfd)
+{
+  act[nact].op = op;
+  act[nact].fd = fd;
+  act[nact].newfd = newfd;
+  nact++;
+}
+
+// Start cmd with spawn() if it is a simple command that resolve()
+// has found, with its standard input from in and output to out
+// unless they are -1, and with other closed. Its redirections are
+// opened here and passed on. Returns the pid, or -1 if cmd is to
+// be forked instead, which also reports any error.
+int
+spawncmd(struct cmd *cmd, int in, int out, int other)
+{
+  struct redircmd *rcmd;
+  struct execcmd *ecmd;
+  int opened[NREDIR], nopen, i, fd, pid;
+
+  if(nospawn)
+    return -1;
+  nact = nopen = 0;
+  if(in >= 0){
+    action(SPAWN_DUP, in, 0);
+    action(SPAWN_CLOSE, in, 0);
+  }
+  if(out >= 0){
+    action(SPAWN_DUP, out, 1);
+    action(SPAWN_CLOSE, out, 0);
+  }
+  if(other >= 0)
+    action(SPAWN_CLOSE, other, 0);
+
+  // Outermost first, as runcmd() does them.
+  pid = -1;
+  for(; cmd->type == REDIR; cmd = rcmd->cmd){
+    rcmd = (struct redircmd*)cmd;
+    if(nopen == NREDIR || (fd = open(rcmd->file, rcmd->mode)) < 0)
+      goto out;
+    opened[nopen++] = fd;
+    action(SPAWN_DUP, fd, rcmd->fd);
+    action(SPAWN_CLOSE, fd, 0);
+  }
+  ecmd = (struct execcmd*)cmd;
+  if(cmd->type == EXEC && ecmd->path != 0)
+    pid = spawn(ecmd->path, ecmd->argv, act, nact);
+
+out:
+  for(i = 0; i < nopen; i++)
+    close(opened[i]);
+  return pid;
+}
+
+// Start the stages of pipeline cmd, or cmd alone if it is not
+// one, each in a process of its own with its standard output
+// piped to the next one's input. All are started from this
+// process in one pass, simple commands with spawn() and the rest
+// with fork(); past MAXSTAGE, the last runs the rest.
+// Returns how many were started, with their pids in pid[].
+int
+launch(struct cmd *cmd, int *pid)
+{
+  struct cmd *stage;
+  struct pipecmd *pcmd;
+  int n, in, last, p[2];
+
+  in = -1;
+  for(n = 0; ; cmd = pcmd->right){
+    last = cmd->type != PIPE || n == MAXSTAGE-1;
     pcmd = (struct pipecmd*)cmd;
-    if(pipe(p) < 0)
+    stage = last ? cmd : pcmd->left;
+    if(!last && pipe(p) < 0)
       panic("pipe");
-    if(fork1() == 0){
-      close(1);
-      dup(p[1]);
-      close(p[0]);
-      close(p[1]);
-      runcmd(pcmd->left);
-    }
-    if(fork1() == 0){
-      close(0);
-      dup(p[0]);
-      close(p[0]);
-      close(p[1]);
-      runcmd(pcmd->right);
+    resolve(stage);
+    pid[n] = spawncmd(stage, in, last ? -1 : p[1], last ? -1 : p[0]);
+    if(pid[n] < 0 && (pid[n] = fork1()) == 0){
+      if(in >= 0){
+        close(0);
+        dup(in);
+        close(in);
+      }
+      if(!last){
+        close(1);
+        dup(p[1]);
+        close(p[0]);
+        close(p[1]);
+      }
+      runcmd(stage);
     }
-    close(p[0]);
+    n++;
+    if(in >= 0)
+      close(in);
+    if(last)
+      return n;
     close(p[1]);
-    wait();
-    wait();
+    in = p[0];
+  }
+}
+
+// Note the exit of process pid in its job.
+void
+reap(int pid)
+{
+  struct job *j;
+  int i;
+
+  for(j = &fg; j <= &jobs[NJOB-1]; j = (j == &fg) ? jobs : j+1){
+    for(i = 0; i < j->npid; i++){
+      if(j->pid[i] == pid){
+        j->pid[i] = 0;
+        if(--j->nlive == 0 && j != &fg)
+          j->done = 1;
+        return;
+      }
+    }
+  }
+}
+
+// Wait for the processes of job j, reaping any others that exit
+// first.
+void
+waitjob(struct job *j)
+{
+  int pid;
+
+  while(j->nlive > 0){
+    if((pid = wait()) < 0){
+      j->nlive = 0;
+      if(j != &fg)
+        j->done = 1;
+      break;
+    }
+    reap(pid);
+  }
+}
+
+// Report background jobs that have finished, and free them.
+void
+notify(void)
+{
+  int i;
+
+  for(i = 0; i < NJOB; i++){
+    if(jobs[i].id != 0 && jobs[i].done){
+      printf(2, "[%d] done\t%s", jobs[i].id, jobs[i].line);
+      jobs[i].id = 0;
+    }
+  }
+}
+
+// Run cmd from the shell itself: lists in order, each & command
+// as a background job, and the rest as the foreground job.
+// line is the command line, for reports on background jobs.
+void
+run(struct cmd *cmd, char *line)
+{
+  struct listcmd *lcmd;
+  struct backcmd *bcmd;
+  struct job *j;
+  int i;
+
+  switch(cmd->type){
+  case LIST:
+    lcmd = (struct listcmd*)cmd;
+    run(lcmd->left, line);
+    run(lcmd->right, line);
     break;
 
   case BACK:
     bcmd = (struct backcmd*)cmd;
-    if(fork1() == 0)
-      runcmd(bcmd->cmd);
+    for(i = 0; i < NJOB && jobs[i].id != 0; i++)
+      ;
+    if(i == NJOB){
+      printf(2, "sh: too many jobs\n");
+      break;
+    }
+    j = &jobs[i];
+    j->id = i+1;
+    j->done = 0;
+    strcpy(j->line, line);
+    j->npid = j->nlive = launch(bcmd->cmd, j->pid);
+    printf(2, "[%d] %d\n", j->id, j->pid[j->npid-1]);
+    break;
+
+  default:
+    fg.npid = fg.nlive = launch(cmd, fg.pid);
+    waitjob(&fg);
     break;
   }
-  exit();
+}
+
+// Set the path of the program that cmd runs, if it is a simple
+// command, to argv[0] if that names a file: what exec(argv[0])
+// would find.
+void
+resolve(struct cmd *cmd)
+{
+  struct execcmd *ecmd;
+  struct stat st;
+  char *name;
+  int i;
+
+  while(cmd->type == REDIR)
+    cmd = ((struct redircmd*)cmd)->cmd;
+  if(cmd->type != EXEC)
+    return;
+  ecmd = (struct execcmd*)cmd;
+  name = ecmd->argv[0];
+  if(name == 0)
+    return;
+
+  for(i = 0; i < NPATH; i++){
+    if(strcmp(pathcache[i], name) == 0){
+      ecmd->path = name;
+      return;
+    }
+  }
+  if(stat(name, &st) < 0 || st.type != T_FILE)
+    return;
+  ecmd->path = name;
+  if(strlen(name) < sizeof(pathcache[0]))
+    strcpy(pathcache[pathnext++ % NPATH], name);
+}
+
+// Run buf if it is a built-in command. Returns 1 if it was.
+int
+builtin(char *buf)
+{
+  int i, n;
+
+  if(buf[0] == 'c' && buf[1] == 'd' && buf[2] == ' '){
+    // Chdir must be called by the parent, not the child.
+    buf[strlen(buf)-1] = 0;  // chop \n
+    if(chdir(buf+3) < 0)
+      printf(2, "cannot cd %s\n", buf+3);
+    memset(pathcache, 0, sizeof(pathcache));
+    return 1;
+  }
+  if(strcmp(buf, "jobs\n") == 0){
+    notify();
+    for(i = 0; i < NJOB; i++)
+      if(jobs[i].id != 0)
+        printf(2, "[%d] running\t%s", jobs[i].id, jobs[i].line);
+    return 1;
+  }
+  if(strcmp(buf, "wait\n") == 0){
+    for(i = 0; i < NJOB; i++)
+      if(jobs[i].id != 0)
+        waitjob(&jobs[i]);
+    notify();
+    return 1;
+  }
+  if(buf[0] == 'f' && buf[1] == 'g' && (buf[2] == '\n' || buf[2] == ' ')){
+    // Wait for job n, or the highest-numbered one.
+    n = buf[2] == ' ' ? atoi(buf+3) : 0;
+    for(i = NJOB-1; i >= 0; i--)
+      if(jobs[i].id != 0 && (n == 0 || jobs[i].id == n))
+        break;
+    if(i < 0)
+      printf(2, "fg: no such job\n");
+    else
+      waitjob(&jobs[i]);
+    notify();
+    return 1;
+  }
+  return 0;
 }
 
 int
 getcmd(char *buf, int nbuf)
 {
+  notify();
   printf(2, "$ ");
   memset(buf, 0, nbuf);
   gets(buf, nbuf);
@@ -142,9 +425,10 @@ getcmd(char *buf, int nbuf)
 }
 
 int
-main(void)
+main(int argc, char *argv[])
 {
-  static char buf[100];
+  static char buf[100], line[100];
+  struct cmd *cmd;
   int fd;
 
   // Ensure that three file descriptors are open.
@@ -155,18 +439,16 @@ main(void)
     }
   }
 
+  if(argc > 1 && strcmp(argv[1], "-f") == 0)
+    nospawn = 1;
+
   // Read and run input commands.
   while(getcmd(buf, sizeof(buf)) >= 0){
-    if(buf[0] == 'c' && buf[1] == 'd' && buf[2] == ' '){
-      // Chdir must be called by the parent, not the child.
-      buf[strlen(buf)-1] = 0;  // chop \n
-      if(chdir(buf+3) < 0)
-        printf(2, "cannot cd %s\n", buf+3);
+    if(builtin(buf))
       continue;
-    }
-    if(fork1() == 0)
-      runcmd(parsecmd(buf));
-    wait();
+    strcpy(line, buf);  // parsecmd() cuts buf up
+    if((cmd = parsecmd(buf)) != 0)
+      run(cmd, line);
   }
   exit();
 }
@@ -192,13 +474,37 @@ fork1(void)
 //PAGEBREAK!
 // Constructors
 
+// Parsed commands are allocated from one arena, emptied for each
+// command line, so the shell never frees them one by one.
+// 100 bytes of input make at most about 50 commands.
+char arena[50 * sizeof(struct execcmd) + 64 * sizeof(struct redircmd)];
+char *arenap;
+int parseerr;  // the line being parsed is bad
+
+void syntax(char*);
+
+void*
+alloc(int n)
+{
+  char *p;
+
+  n = (n + 3) & ~3;
+  if(arenap + n > arena + sizeof(arena)){
+    syntax("command too long");
+    arenap = arena;  // the parse will be thrown away
+  }
+  p = arenap;
+  arenap += n;
+  memset(p, 0, n);
+  return p;
+}
+
 struct cmd*
 execcmd(void)
 {
   struct execcmd *cmd;
 
-  cmd = malloc(sizeof(*cmd));
-  memset(cmd, 0, sizeof(*cmd));
+  cmd = alloc(sizeof(*cmd));
   cmd->type = EXEC;
   return (struct cmd*)cmd;
 }
@@ -208,8 +514,7 @@ redircmd(struct cmd *subcmd, char *file, char *efile, int mode, int fd)
 {
   struct redircmd *cmd;
 
-  cmd = malloc(sizeof(*cmd));
-  memset(cmd, 0, sizeof(*cmd));
+  cmd = alloc(sizeof(*cmd));
   cmd->type = REDIR;
   cmd->cmd = subcmd;
   cmd->file = file;
@@ -224,8 +529,7 @@ pipecmd(struct cmd *left, struct cmd *right)
 {
   struct pipecmd *cmd;
 
-  cmd = malloc(sizeof(*cmd));
-  memset(cmd, 0, sizeof(*cmd));
+  cmd = alloc(sizeof(*cmd));
   cmd->type = PIPE;
   cmd->left = left;
   cmd->right = right;
@@ -237,8 +541,7 @@ listcmd(struct cmd *left, struct cmd *right)
 {
   struct listcmd *cmd;
 
-  cmd = malloc(sizeof(*cmd));
-  memset(cmd, 0, sizeof(*cmd));
+  cmd = alloc(sizeof(*cmd));
   cmd->type = LIST;
   cmd->left = left;
   cmd->right = right;
@@ -250,8 +553,7 @@ backcmd(struct cmd *subcmd)
 {
   struct backcmd *cmd;
 
-  cmd = malloc(sizeof(*cmd));
-  memset(cmd, 0, sizeof(*cmd));
+  cmd = alloc(sizeof(*cmd));
   cmd->type = BACK;
   cmd->cmd = subcmd;
   return (struct cmd*)cmd;
@@ -324,19 +626,35 @@ struct cmd *parsepipe(char**, char*);
 struct cmd *parseexec(char**, char*);
 struct cmd *nulterminate(struct cmd*);
 
+// Report a bad command line. Parsing carries on, as every
+// gettoken() moves on, but parsecmd() then returns 0.
+void
+syntax(char *msg)
+{
+  if(!parseerr)
+    printf(2, "%s\n", msg);
+  parseerr = 1;
+}
+
+// Parse s into the arena, which is emptied first. Returns 0 if
+// s is not a good command line.
 struct cmd*
 parsecmd(char *s)
 {
   char *es;
   struct cmd *cmd;
 
+  arenap = arena;
+  parseerr = 0;
   es = s + strlen(s);
   cmd = parseline(&s, es);
   peek(&s, es, "");
-  if(s != es){
+  if(s != es && !parseerr){
     printf(2, "leftovers: %s\n", s);
-    panic("syntax");
+    syntax("syntax");
   }
+  if(parseerr)
+    return 0;
   nulterminate(cmd);
   return cmd;
 }
@@ -379,8 +697,10 @@ parseredirs(struct cmd *cmd, char **ps, char *es)
 
   while(peek(ps, es, "<>")){
     tok = gettoken(ps, es, 0, 0);
-    if(gettoken(ps, es, &q, &eq) != 'a')
-      panic("missing file for redirection");
+    if(gettoken(ps, es, &q, &eq) != 'a'){
+      syntax("missing file for redirection");
+      break;
+    }
     switch(tok){
     case '<':
       cmd = redircmd(cmd, q, eq, O_RDONLY, 0);
@@ -405,8 +725,10 @@ parseblock(char **ps, char *es)
     panic("parseblock");
   gettoken(ps, es, 0, 0);
   cmd = parseline(ps, es);
-  if(!peek(ps, es, ")"))
-    panic("syntax - missing )");
+  if(!peek(ps, es, ")")){
+    syntax("syntax - missing )");
+    return cmd;
+  }
   gettoken(ps, es, 0, 0);
   cmd = parseredirs(cmd, ps, es);
   return cmd;
@@ -431,13 +753,17 @@ parseexec(char **ps, char *es)
   while(!peek(ps, es, "|)&;")){
     if((tok=gettoken(ps, es, &q, &eq)) == 0)
       break;
-    if(tok != 'a')
-      panic("syntax");
+    if(tok != 'a'){
+      syntax("syntax");
+      break;
+    }
+    if(argc >= MAXARGS-1){  // leave room for the terminator
+      syntax("too many args");
+      break;
+    }
     cmd->argv[argc] = q;
     cmd->eargv[argc] = eq;
     argc++;
-    if(argc >= MAXARGS)
-      panic("too many args");
     ret = parseredirs(ret, ps, es);
   }
   cmd->argv[argc] = 0;
@@ -0,0 +1,81 @@
+// Shell command rate: run a script of simple commands through sh,
+// which starts them with spawn(), and through sh -f, which forks
+// and execs each, and print commands per second for each.
+//
+//   shbench [commands]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+char *script[] = {
+  "echo hello\n",
+  "echo a b c > shbench.tmp\n",
+  "cat shbench.tmp\n",
+  "echo x | wc\n",  // two commands
+};
+
+// Run sh with flag, if not 0, on shbench.sh. Returns the ticks taken.
+int
+run(char *flag)
+{
+  char *argv[3];
+  int t;
+
+  t = uptime();
+  if(fork() == 0){
+    close(0);
+    close(1);
+    close(2);
+    if(open("shbench.sh", O_RDONLY) != 0 ||
+       open("shbench.out", O_CREATE | O_WRONLY) != 1 || dup(1) != 2)
+      exit();
+    argv[0] = "sh";
+    argv[1] = flag;
+    argv[2] = 0;
+    exec("sh", argv);
+    exit();
+  }
+  wait();
+  return uptime() - t;
+}
+
+void
+report(char *name, int n, int t)
+{
+  printf(1, "%s: %d commands, %d ticks", name, n, t);
+  if(t > 0)
+    printf(1, ", %d commands/s", n * 100 / t);
+  printf(1, "\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, i, fd, ncmd;
+  char *s;
+
+  n = argc > 1 ? atoi(argv[1]) : 200;
+  unlink("shbench.sh");
+  if((fd = open("shbench.sh", O_CREATE | O_WRONLY)) < 0){
+    printf(1, "shbench: cannot create shbench.sh\n");
+    exit();
+  }
+  for(i = ncmd = 0; ncmd < n; i++){
+    s = script[i % (sizeof(script)/sizeof(script[0]))];
+    write(fd, s, strlen(s));
+    ncmd += strchr(s, '|') ? 2 : 1;
+  }
+  close(fd);
+
+  unlink("shbench.out");
+  report("spawn     ", ncmd, run(0));
+  unlink("shbench.out");
+  report("fork+exec ", ncmd, run("-f"));
+
+  unlink("shbench.out");
+  unlink("shbench.tmp");
+  unlink("shbench.sh");
+  exit();
+}
@@ -11,3 +11,40 @@ struct stat {
   short nlink; // Number of links to file
   uint size;   // Size of file in bytes
 };
+
+// File system and disk counters, returned by fsstat().
+struct fsstat {
+  uint commits;      // log transactions committed
+  uint logwrites;    // blocks written to the on-disk log
+  uint checkpoints;  // times the log was installed and emptied
+  uint installs;     // blocks copied from the log to their home location
+  uint absorbed;     // installs skipped, superseded by a later log copy
+  uint diskcmds;     // disk commands issued
+  uint diskreads;    // blocks read from disk
+  uint diskwrites;   // blocks written to disk
+  uint bmaphits;     // bmap() lookups served from the inode's run cache
+  uint bmapmisses;   // bmap() lookups that walked the block map
+  uint dcachehits;   // dirlookup()s answered by the directory entry cache
+  uint dcachemisses; // dirlookup()s that read the directory
+  uint icachehits;   // iget()s that found the inode cached
+  uint icachemisses; // iget()s that recycled a cache entry
+};
+
+#define NSYSSTAT 40  // must exceed the highest SYS_ number
+#define NSYSHIST 16  // latency buckets per system call
+
+// Latency is in TSC cycles spent in syscall(). hist[0] counts calls
+// of under 256 cycles, hist[i] calls of 2^(i+7) up to 2^(i+8), and
+// the last bucket everything longer. Calls that do not return, like
+// exit, are counted but not timed.
+struct syscallstat {
+  uint count;
+  uint64 cycles;
+  uint hist[NSYSHIST];
+};
+
+struct sysstat {
+  uint fastentries;  // system calls entered with sysenter
+  uint trapentries;  // system calls entered with int $T_SYSCALL
+  struct syscallstat call[NSYSSTAT];
+};
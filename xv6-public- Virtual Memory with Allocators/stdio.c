@@ -0,0 +1,241 @@
+// Buffered standard I/O.
+//
+// A stream collects the output for an fd, or the input from one,
+// in a buffer, so that printf() and friends cost one write() per
+// line or per buffer rather than one per call. stdout is line
+// buffered on the console and fully buffered into a file or pipe;
+// stderr is flushed at the end of every call. Once a stream is in
+// use, exit(), fork() and exec() flush them all first (see
+// stdioflush in ulib.c).
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+static char inbuf[BUFSIZ], outbuf[BUFSIZ], errbuf[128];
+
+static struct stream streams[3] = {
+  { 0, 0, 1, inbuf, sizeof(inbuf) },
+  { 1, 0, 0, outbuf, sizeof(outbuf) },
+  { 2, _IONBF, 0, errbuf, sizeof(errbuf) },
+};
+struct stream *stdin = &streams[0];
+struct stream *stdout = &streams[1];
+struct stream *stderr = &streams[2];
+
+static void
+flushall(void)
+{
+  fflush(stdout);
+  fflush(stderr);
+}
+
+// Settle s's buffering on first use: by line for a device such as
+// the console, by the buffer for a file or pipe.
+static void
+setup(struct stream *s)
+{
+  struct stat st;
+
+  if(s->mode == 0)
+    s->mode = fstat(s->fd, &st) == 0 && st.type == T_DEV ? _IOLBF : _IOFBF;
+  stdioflush = flushall;
+}
+
+// Write out what s has buffered. fflush(0) flushes every stream.
+int
+fflush(struct stream *s)
+{
+  int n;
+
+  if(s == 0){
+    flushall();
+    return 0;
+  }
+  if(s->rd || s->n == 0)
+    return 0;
+  n = s->n;
+  s->n = 0;
+  if(write(s->fd, s->buf, n) != n){
+    s->err = 1;
+    return -1;
+  }
+  return 0;
+}
+
+static void
+put(struct stream *s, char c)
+{
+  if(s->n == s->size)
+    fflush(s);
+  s->buf[s->n++] = c;
+  if(c == '\n' && s->mode == _IOLBF)
+    fflush(s);
+}
+
+// Every output call ends here.
+static int
+done(struct stream *s)
+{
+  if(s->mode == _IONBF)
+    fflush(s);
+  return s->err ? -1 : 0;
+}
+
+int
+fputc(int c, struct stream *s)
+{
+  setup(s);
+  put(s, c);
+  return done(s) < 0 ? -1 : (c & 0xff);
+}
+
+int
+fputs(const char *str, struct stream *s)
+{
+  setup(s);
+  while(*str)
+    put(s, *str++);
+  return done(s);
+}
+
+// Next byte from s, or -1 at end of file. Output waiting on
+// stdout, such as a prompt, is flushed before blocking on a read.
+int
+fgetc(struct stream *s)
+{
+  int n;
+
+  if(s->pos == s->n){
+    setup(s);
+    fflush(stdout);
+    if((n = read(s->fd, s->buf, s->size)) <= 0){
+      s->n = s->pos = 0;
+      return -1;
+    }
+    s->n = n;
+    s->pos = 0;
+  }
+  return s->buf[s->pos++] & 0xff;
+}
+
+// Read a line, including its newline, of at most max-1 bytes.
+// Returns 0 at end of file.
+char*
+fgets(char *buf, int max, struct stream *s)
+{
+  int i, c;
+
+  for(i = 0; i+1 < max; ){
+    if((c = fgetc(s)) < 0)
+      break;
+    buf[i++] = c;
+    if(c == '\n')
+      break;
+  }
+  buf[i] = '\0';
+  return i > 0 ? buf : 0;
+}
+
+static void
+printint(struct stream *s, int xx, int base, int sgn)
+{
+  static char digits[] = "0123456789ABCDEF";
+  char buf[16];
+  int i, neg;
+  uint x;
+
+  neg = 0;
+  if(sgn && xx < 0){
+    neg = 1;
+    x = -xx;
+  } else {
+    x = xx;
+  }
+
+  i = 0;
+  do{
+    buf[i++] = digits[x % base];
+  }while((x /= base) != 0);
+  if(neg)
+    buf[i++] = '-';
+
+  while(--i >= 0)
+    put(s, buf[i]);
+}
+
+// Format into s. Only understands %d, %x, %p, %s, %c.
+static int
+format(struct stream *s, const char *fmt, uint *ap)
+{
+  char *str;
+  int c, i, state;
+
+  setup(s);
+  state = 0;
+  for(i = 0; fmt[i]; i++){
+    c = fmt[i] & 0xff;
+    if(state == 0){
+      if(c == '%'){
+        state = '%';
+      } else {
+        put(s, c);
+      }
+    } else if(state == '%'){
+      if(c == 'd'){
+        printint(s, *ap, 10, 1);
+        ap++;
+      } else if(c == 'x' || c == 'p'){
+        printint(s, *ap, 16, 0);
+        ap++;
+      } else if(c == 's'){
+        str = (char*)*ap;
+        ap++;
+        if(str == 0)
+          str = "(null)";
+        while(*str)
+          put(s, *str++);
+      } else if(c == 'c'){
+        put(s, *ap);
+        ap++;
+      } else if(c == '%'){
+        put(s, c);
+      } else {
+        // Unknown % sequence.  Print it to draw attention.
+        put(s, '%');
+        put(s, c);
+      }
+      state = 0;
+    }
+  }
+  return done(s);
+}
+
+int
+fprintf(struct stream *s, const char *fmt, ...)
+{
+  return format(s, fmt, (uint*)(void*)&fmt + 1);
+}
+
+// Print to the given fd: through stdout or stderr for 1 and 2,
+// and otherwise with one write() per call.
+void
+printf(int fd, const char *fmt, ...)
+{
+  struct stream s;
+  char buf[128];
+
+  if(fd == 1 || fd == 2){
+    format(&streams[fd], fmt, (uint*)(void*)&fmt + 1);
+    return;
+  }
+  s.fd = fd;
+  s.mode = _IONBF;
+  s.rd = 0;
+  s.buf = buf;
+  s.size = sizeof(buf);
+  s.n = 0;
+  s.pos = 0;
+  s.err = 0;
+  format(&s, fmt, (uint*)(void*)&fmt + 1);
+}
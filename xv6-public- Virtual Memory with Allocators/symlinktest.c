@@ -64,10 +64,59 @@ main(void)
   }
   printf(1, "Successfully detected symlink cycle\n");
 
-  printf(1, "\nTest 5: Cleanup\n");
+  printf(1, "\nTest 5: Symlinks to directories\n");
+  if(mkdir("sdir") < 0 || mkdir("sdir/sub") < 0 ||
+     (fd = open("sdir/sub/file", O_CREATE | O_RDWR)) < 0){
+    printf(1, "Failed to create sdir/sub/file\n");
+    exit();
+  }
+  write(fd, "in sub", 6);
+  close(fd);
+  // A relative target is looked up in the link's own directory.
+  if(symlink("sdir", "dlink") < 0 || symlink("sub", "sdir/sublink") < 0){
+    printf(1, "Failed to create directory symlinks\n");
+    exit();
+  }
+  if((fd = open("dlink/sublink/file", O_RDONLY)) < 0){
+    printf(1, "Error: symlinks inside a path were not followed\n");
+    exit();
+  }
+  close(fd);
+  if(chdir("dlink/sublink") < 0 || (fd = open("file", O_RDONLY)) < 0){
+    printf(1, "Error: chdir through a symlink failed\n");
+    exit();
+  }
+  close(fd);
+  chdir("/");
+  if((fd = open("dlink", O_RDONLY | O_NOFOLLOW)) >= 0){
+    printf(1, "Error: O_NOFOLLOW opened a link to a directory\n");
+    close(fd);
+    exit();
+  }
+  printf(1, "Directory symlinks working correctly\n");
+
+  printf(1, "\nTest 6: Long targets\n");
+  // Too long to be kept in the inode (more than sizeof(addrs),
+  // 52 bytes), so it takes a data block.
+  if(symlink("/sdir/sub/../sub/../sub/../sub/../sub/../sub/../sub/../sub/file", "link6") < 0){
+    printf(1, "Failed to create symlink with a long target\n");
+    exit();
+  }
+  memset(buf, 0, sizeof(buf));
+  if((fd = open("link6", O_RDONLY)) < 0 || read(fd, buf, sizeof(buf)) != 6){
+    printf(1, "Error: failed to read through long symlink\n");
+    exit();
+  }
+  close(fd);
+  printf(1, "Content through long symlink: %s\n", buf);
+
+  printf(1, "\nTest 7: Cleanup\n");
   if(unlink("link1") < 0 || unlink("link2") < 0 || 
      unlink("link3") < 0 || unlink("link4") < 0 || 
-     unlink("link5") < 0){
+     unlink("link5") < 0 || unlink("link6") < 0 ||
+     unlink("dlink") < 0 || unlink("sdir/sublink") < 0 ||
+     unlink("sdir/sub/file") < 0 || unlink("sdir/sub") < 0 ||
+     unlink("sdir") < 0){
     printf(1, "Failed to unlink symlinks\n");
     exit();
   }
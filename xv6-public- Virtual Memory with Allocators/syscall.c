@@ -6,13 +6,16 @@
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
+#include "stat.h"
 
-// User code makes a system call with INT T_SYSCALL.
+// User code makes a system call with SYSENTER, or INT T_SYSCALL.
 // System call number in %eax.
 // Arguments on the stack, from the user call to the C
 // library system call function. The saved user %esp points
 // to a saved program counter, and then the first argument.
 
+struct sysstat sysstats;
+
 // Fetch the int at addr from the current process.
 int
 fetchint(uint addr, int *ip)
@@ -21,6 +24,8 @@ fetchint(uint addr, int *ip)
 
   if(addr >= curproc->sz || addr+4 > curproc->sz)
     return -1;
+  if(uvmtouch(curproc, addr, 4) < 0)
+    return -1;
   *ip = *(int*)(addr);
   return 0;
 }
@@ -39,17 +44,53 @@ fetchstr(uint addr, char **pp)
   *pp = (char*)addr;
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) && uvmtouch(curproc, (uint)s, 1) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
   return -1;
 }
 
+// Copy the words that may be arguments of the current system
+// call into curproc->sysarg with one bounds check. Stops at the
+// end of the stack's page, as what follows may not be mapped;
+// argint() fetches any argument past there on its own. The page
+// is faulted in first, as the stack may be in untouched heap or
+// program memory; if that fails argint() fetches every argument.
+static void
+fetchargs(struct proc *curproc)
+{
+  uint sp, n;
+
+  sp = curproc->tf->esp + 4;
+  n = 0;
+  if(sp >= 4 && sp < curproc->sz){
+    n = PGROUNDDOWN(sp) + PGSIZE - sp;
+    if(n > curproc->sz - sp)
+      n = curproc->sz - sp;
+    n /= 4;
+    if(n > NSYSARG)
+      n = NSYSARG;
+    if(uvmtouch(curproc, sp, n*4) < 0)
+      n = 0;
+    else
+      memmove(curproc->sysarg, (void*)sp, n*4);
+  }
+  curproc->nsysarg = n;
+}
+
 // Fetch the nth 32-bit system call argument.
 int
 argint(int n, int *ip)
 {
-  return fetchint((myproc()->tf->esp) + 4 + 4*n, ip);
+  struct proc *curproc = myproc();
+
+  if(n < curproc->nsysarg){
+    *ip = curproc->sysarg[n];
+    return 0;
+  }
+  return fetchint(curproc->tf->esp + 4 + 4*n, ip);
 }
 
 // Fetch the nth word-sized system call argument as a pointer
@@ -63,7 +104,12 @@ argptr(int n, char **pp, int size)
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  if(size < 0)
+    return -1;
+  if((uint)i >= curproc->sz || (uint)i+size > curproc->sz){
+    if(vmatouch(curproc, i, size) < 0)
+      return -1;
+  } else if(uvmtouch(curproc, i, size) < 0)
     return -1;
   *pp = (char*)i;
   return 0;
@@ -105,6 +151,17 @@ extern int sys_write(void);
 extern int sys_uptime(void);
 extern int sys_lseek(void);
 extern int sys_symlink(void);
+extern int sys_fsstat(void);
+extern int sys_pread(void);
+extern int sys_pwrite(void);
+extern int sys_readv(void);
+extern int sys_writev(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_sendfile(void);
+extern int sys_fcntl(void);
+extern int sys_sysstat(void);
+extern int sys_spawn(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -130,18 +187,48 @@ static int (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_lseek]    sys_lseek,
 [SYS_symlink]    sys_symlink,
+[SYS_fsstat]  sys_fsstat,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
+[SYS_sendfile] sys_sendfile,
+[SYS_fcntl]   sys_fcntl,
+[SYS_sysstat] sys_sysstat,
+[SYS_spawn]   sys_spawn,
 
 };
 
+// Record that system call num took dt cycles.
+static void
+systime(int num, uint64 dt)
+{
+  struct syscallstat *s;
+  int b;
+
+  s = &sysstats.call[num];
+  s->cycles += dt;
+  for(b = 0; b < NSYSHIST-1 && dt >= (256ULL << b); b++)
+    ;
+  s->hist[b]++;
+}
+
 void
 syscall(void)
 {
   int num;
+  uint64 t0;
   struct proc *curproc = myproc();
 
   num = curproc->tf->eax;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    sysstats.call[num].count++;
+    t0 = rdtsc();
+    fetchargs(curproc);
     curproc->tf->eax = syscalls[num]();
+    systime(num, rdtsc() - t0);
   } else {
     cprintf("%d %s: unknown sys call %d\n",
             curproc->pid, curproc->name, num);
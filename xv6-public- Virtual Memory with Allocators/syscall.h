@@ -21,4 +21,15 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 #define SYS_lseek  22  
-#define SYS_symlink 23
\ No newline at end of file
+#define SYS_symlink 23
+#define SYS_fsstat 24
+#define SYS_pread  25
+#define SYS_pwrite 26
+#define SYS_readv  27
+#define SYS_writev 28
+#define SYS_mmap   29
+#define SYS_munmap 30
+#define SYS_sendfile 31
+#define SYS_fcntl  32
+#define SYS_sysstat 33
+#define SYS_spawn  34
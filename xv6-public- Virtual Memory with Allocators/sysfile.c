@@ -7,6 +7,7 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "memlayout.h"
 #include "stat.h"
 #include "mmu.h"
 #include "proc.h"
@@ -16,7 +17,6 @@
 #include "file.h"
 #include "fcntl.h"
 
-#define MAXSYMLINKS 10
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
 static int
@@ -91,6 +91,132 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+// Copy the array of niov iovecs at argument n into iov, checking
+// that each buffer lies within the process's memory.
+static int
+argiov(int n, int niov, struct iovec *iov)
+{
+  struct proc *curproc = myproc();
+  char *p;
+  int i;
+
+  if(niov < 0 || niov > NIOV || argptr(n, &p, niov * sizeof(*iov)) < 0)
+    return -1;
+  memmove(iov, p, niov * sizeof(*iov));
+  for(i = 0; i < niov; i++){
+    if(iov[i].len < 0)
+      return -1;
+    if(iov[i].len == 0)
+      continue;
+    if((uint)iov[i].base >= curproc->sz ||
+       (uint)iov[i].base + iov[i].len > curproc->sz){
+      if(vmatouch(curproc, (uint)iov[i].base, iov[i].len) < 0)
+        return -1;
+    } else if(uvmtouch(curproc, (uint)iov[i].base, iov[i].len) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// readv(fd, iov, n) and writev(fd, iov, n) read into or write
+// from n buffers with one call. On a file, writev() puts as many
+// buffers in each log transaction as will fit, so a header and
+// its record commit together.
+int
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[NIOV];
+  int n;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argiov(1, n, iov) < 0)
+    return -1;
+  return filereadv(f, iov, n);
+}
+
+int
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[NIOV];
+  int n;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argiov(1, n, iov) < 0)
+    return -1;
+  return filewritev(f, iov, n);
+}
+
+// sendfile(out, in, off, n) copies up to n bytes of file in to
+// out inside the kernel. With off -1 it reads from, and advances,
+// in's offset; otherwise it reads from off and leaves the offset
+// alone. Returns the number of bytes copied, 0 at end of file.
+int
+sys_sendfile(void)
+{
+  struct file *out, *in;
+  int off, n;
+  uint o;
+
+  if(argfd(0, 0, &out) < 0 || argfd(1, 0, &in) < 0 ||
+     argint(2, &off) < 0 || argint(3, &n) < 0 || off < -1)
+    return -1;
+  if(off == -1)
+    return filesendfile(out, in, &in->off, n);
+  o = off;
+  return filesendfile(out, in, &o, n);
+}
+
+// fcntl(fd, cmd, arg): F_GETPIPE_SZ returns the size of a
+// pipe's buffer; F_SETPIPE_SZ makes it at least arg bytes and
+// returns the new size.
+int
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &cmd) < 0 || argint(2, &arg) < 0)
+    return -1;
+  if(f->type != FD_PIPE)
+    return -1;
+  switch(cmd){
+  case F_GETPIPE_SZ:
+    return pipesize(f->pipe);
+  case F_SETPIPE_SZ:
+    return piperesize(f->pipe, arg);
+  }
+  return -1;
+}
+
+// pread(fd, buf, n, off) and pwrite(fd, buf, n, off) are read()
+// and write() at offset off, leaving the file's offset alone, so
+// processes sharing a file need not seek first.
+int
+sys_pread(void)
+{
+  struct file *f;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  return filepread(f, p, n, off);
+}
+
+int
+sys_pwrite(void)
+{
+  struct file *f;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  return filepwrite(f, p, n, off);
+}
+
 int
 sys_close(void)
 {
@@ -186,7 +312,6 @@ int
 sys_unlink(void)
 {
   struct inode *ip, *dp;
-  struct dirent de;
   char name[DIRSIZ], *path;
   uint off;
 
@@ -216,9 +341,7 @@ sys_unlink(void)
     goto bad;
   }
 
-  memset(&de, 0, sizeof(de));
-  if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-    panic("unlink: writei");
+  dirunlink(dp, name, off);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -303,53 +426,24 @@ sys_open(void)
       end_op();
       return -1;
     }
+    // An empty file has no blocks yet and can switch format.
+    if((omode & O_EXTENT) && ip->type == T_FILE && ip->size == 0 &&
+       (ip->flags & I_EXTENT) == 0){
+      ip->flags |= I_EXTENT;
+      iupdate(ip);
+    }
   } else {
-    if((ip = namei(path)) == 0){
+    // namei() follows a symlink at the end of the path.
+    ip = (omode & O_NOFOLLOW) ? nameinofollow(path) : namei(path);
+    if(ip == 0){
       end_op();
       return -1;
     }
     ilock(ip);
-
-    // First check if it's a symlink and O_NOFOLLOW is set
-    if(ip->type == T_SYMLINK && (omode & O_NOFOLLOW)){
+    if(ip->type == T_SYMLINK){
       iunlockput(ip);
       end_op();
-      return -1;  // Fail immediately if O_NOFOLLOW and it's a symlink
-    }
-
-    // Only follow symlinks if O_NOFOLLOW is not set
-    if(ip->type == T_SYMLINK && !(omode & O_NOFOLLOW)){
-      char target[MAXPATH];
-      int symlink_depth = 0;
-      struct inode *next;
-
-      while(symlink_depth < MAXSYMLINKS) {
-        int n = readi(ip, target, 0, sizeof(target)-1);
-        if(n < 0) {
-          iunlockput(ip);
-          end_op();
-          return -1;
-        }
-        target[n] = 0;
-        iunlockput(ip);
-
-        if((next = namei(target)) == 0) {
-          end_op();
-          return -1;
-        }
-        ip = next;
-        ilock(ip);
-
-        if(ip->type != T_SYMLINK)
-          break;
-
-        symlink_depth++;
-        if(symlink_depth >= MAXSYMLINKS) {
-          iunlockput(ip);
-          end_op();
-          return -1;
-        }
-      }
+      return -1;
     }
   }
 
@@ -433,19 +527,17 @@ sys_chdir(void)
   return 0;
 }
 
-int
-sys_exec(void)
+// Copy the user argv array at uargv into argv, whose strings are
+// left in user memory.
+static int
+fetchargv(uint uargv, char **argv)
 {
-  char *path, *argv[MAXARG];
   int i;
-  uint uargv, uarg;
+  uint uarg;
 
-  if(argstr(0, &path) < 0 || argint(1, (int*)&uargv) < 0){
-    return -1;
-  }
-  memset(argv, 0, sizeof(argv));
+  memset(argv, 0, MAXARG*sizeof(argv[0]));
   for(i=0;; i++){
-    if(i >= NELEM(argv))
+    if(i >= MAXARG)
       return -1;
     if(fetchint(uargv+4*i, (int*)&uarg) < 0)
       return -1;
@@ -456,9 +548,42 @@ sys_exec(void)
     if(fetchstr(uarg, &argv[i]) < 0)
       return -1;
   }
+  return 0;
+}
+
+int
+sys_exec(void)
+{
+  char *path, *argv[MAXARG];
+  uint uargv;
+
+  if(argstr(0, &path) < 0 || argint(1, (int*)&uargv) < 0){
+    return -1;
+  }
+  if(fetchargv(uargv, argv) < 0)
+    return -1;
   return exec(path, argv);
 }
 
+// spawn(path, argv, act, nact): start path in a new process with
+// its files changed by act[0..nact).
+int
+sys_spawn(void)
+{
+  char *path, *argv[MAXARG];
+  struct spawnact *act;
+  uint uargv;
+  int nact;
+
+  if(argstr(0, &path) < 0 || argint(1, (int*)&uargv) < 0 || argint(3, &nact) < 0)
+    return -1;
+  if(nact < 0 || nact > NSPAWNACT || argptr(2, (char**)&act, nact*sizeof(*act)) < 0)
+    return -1;
+  if(fetchargv(uargv, argv) < 0)
+    return -1;
+  return spawn(path, argv, act, nact);
+}
+
 int
 sys_pipe(void)
 {
@@ -500,8 +625,7 @@ sys_symlink(void)
     return -1;
   }
 
-  // Write target path to inode's data block
-  if(writei(ip, target, 0, strlen(target)) != strlen(target)){
+  if(writelink(ip, target) < 0){
     iunlockput(ip);
     end_op();
     return -1;
@@ -512,3 +636,68 @@ sys_symlink(void)
   return 0;
 }
 
+
+
+// Copy the file system and disk counters to user space.
+int
+sys_fsstat(void)
+{
+  struct fsstat *st;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  memmove(st, &fsstats, sizeof(*st));
+  return 0;
+}
+
+// mmap(addr, len, prot, flags, fd, off) maps len bytes of the
+// file open as fd, from page-aligned offset off, or zero-filled
+// memory if flags has MAP_ANON. addr is only a hint and is
+// ignored. Returns the region's address, or MAP_FAILED.
+int
+sys_mmap(void)
+{
+  struct file *f;
+  int addr, len, prot, flags, fd, off;
+  int share;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || argint(2, &prot) < 0 ||
+     argint(3, &flags) < 0 || argint(4, &fd) < 0 || argint(5, &off) < 0)
+    return -1;
+  share = flags & (MAP_SHARED | MAP_PRIVATE);
+  if(len <= 0 || off < 0 || off % PGSIZE != 0 ||
+     (share != MAP_SHARED && share != MAP_PRIVATE))
+    return -1;
+
+  f = 0;
+  if(!(flags & MAP_ANON)){
+    if(argfd(4, 0, &f) < 0 || f->type != FD_INODE || f->ip->type != T_FILE)
+      return -1;
+    if(!f->readable)
+      return -1;
+    if((flags & MAP_SHARED) && (prot & PROT_WRITE) && !f->writable)
+      return -1;
+    filedup(f);
+  }
+  if((addr = vmamap(myproc(), len, prot, flags, f, off)) == 0){
+    if(f)
+      fileclose(f);
+    return -1;
+  }
+  return addr;
+}
+
+// munmap(addr, len) unmaps the pages of [addr, addr+len),
+// writing dirty pages of shared file mappings back first.
+int
+sys_munmap(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  if(addr % PGSIZE != 0 || len <= 0 || (uint)addr + len > MMAPTOP ||
+     (uint)addr + len < (uint)addr)
+    return -1;
+  return vmaunmap(myproc(), addr, PGROUNDUP((uint)addr + len));
+}
@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "stat.h"
  
 int
 sys_fork(void)
@@ -58,6 +59,9 @@ sys_sbrk(void)
       return -1;
   } else {
  
+    // The heap may not grow into an mmap()ed region.
+    if((uint)addr + n > MMAPTOP || vmaoverlap(myproc(), addr, addr + n))
+      return -1;
     myproc()->sz += n;
   }
   return addr;
@@ -84,6 +88,18 @@ sys_sleep(void)
   return 0;
 }
  
+// Copy the system call counters out to the user.
+int
+sys_sysstat(void)
+{
+  struct sysstat *st;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  memmove(st, &sysstats, sizeof(*st));
+  return 0;
+}
+
 int
 sys_uptime(void)
 {
@@ -98,14 +114,14 @@ int
 sys_lseek(void)
 {
   int fd;
-  int offset;
+  int offset, whence;
   struct file *f;
   
-  if(argint(0, &fd) < 0 || argint(1, &offset) < 0)
+  if(argint(0, &fd) < 0 || argint(1, &offset) < 0 || argint(2, &whence) < 0)
     return -1;
     
   if(fd < 0 || fd >= NOFILE || (f = myproc()->ofile[fd]) == 0)
     return -1;
     
-  return fileseek(f, offset);
+  return fileseek(f, offset, whence);
 }
\ No newline at end of file
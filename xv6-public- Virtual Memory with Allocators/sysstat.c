@@ -0,0 +1,172 @@
+// Report how many times each system call was made and how long
+// the calls took, in TSC cycles inside the kernel.
+//
+//   sysstat              since boot
+//   sysstat cmd [args]   while cmd runs (other processes count too)
+//   sysstat -b [n]       cycles per getpid() entering with sysenter
+//                        and with int $T_SYSCALL, n thousand calls each
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+#include "traps.h"
+#include "syscall.h"
+
+char *names[NSYSSTAT] = {
+[SYS_fork]     "fork",
+[SYS_exit]     "exit",
+[SYS_wait]     "wait",
+[SYS_pipe]     "pipe",
+[SYS_read]     "read",
+[SYS_kill]     "kill",
+[SYS_exec]     "exec",
+[SYS_fstat]    "fstat",
+[SYS_chdir]    "chdir",
+[SYS_dup]      "dup",
+[SYS_getpid]   "getpid",
+[SYS_sbrk]     "sbrk",
+[SYS_sleep]    "sleep",
+[SYS_uptime]   "uptime",
+[SYS_open]     "open",
+[SYS_write]    "write",
+[SYS_mknod]    "mknod",
+[SYS_unlink]   "unlink",
+[SYS_link]     "link",
+[SYS_mkdir]    "mkdir",
+[SYS_close]    "close",
+[SYS_lseek]    "lseek",
+[SYS_symlink]  "symlink",
+[SYS_fsstat]   "fsstat",
+[SYS_pread]    "pread",
+[SYS_pwrite]   "pwrite",
+[SYS_readv]    "readv",
+[SYS_writev]   "writev",
+[SYS_mmap]     "mmap",
+[SYS_munmap]   "munmap",
+[SYS_sendfile] "sendfile",
+[SYS_fcntl]    "fcntl",
+[SYS_sysstat]  "sysstat",
+[SYS_spawn]    "spawn",
+};
+
+struct sysstat before, after;
+
+// cycles/n without 64-bit division, which would need libgcc.
+uint
+avg(uint64 cycles, uint n)
+{
+  int shift;
+
+  if(n == 0)
+    return 0;
+  for(shift = 0; cycles > 0xffffffffULL; shift++)
+    cycles >>= 1;
+  return ((uint)cycles / n) << shift;
+}
+
+// Subtract before from after.
+void
+delta(void)
+{
+  int i, b;
+
+  after.fastentries -= before.fastentries;
+  after.trapentries -= before.trapentries;
+  for(i = 0; i < NSYSSTAT; i++){
+    after.call[i].count -= before.call[i].count;
+    after.call[i].cycles -= before.call[i].cycles;
+    for(b = 0; b < NSYSHIST; b++)
+      after.call[i].hist[b] -= before.call[i].hist[b];
+  }
+}
+
+void
+report(struct sysstat *st)
+{
+  struct syscallstat *s;
+  int i, b;
+
+  printf(1, "%d entries with sysenter, %d with int\n",
+         st->fastentries, st->trapentries);
+  printf(1, "call\tcount\tavg\tlatency histogram (<2^k cycles: calls)\n");
+  for(i = 0; i < NSYSSTAT; i++){
+    s = &st->call[i];
+    if(s->count == 0)
+      continue;
+    printf(1, "%s\t%d\t%d\t", names[i] ? names[i] : "?", s->count,
+           avg(s->cycles, s->count));
+    for(b = 0; b < NSYSHIST; b++){
+      if(s->hist[b] == 0)
+        continue;
+      if(b == NSYSHIST-1)
+        printf(1, " >=2^%d:%d", b+7, s->hist[b]);
+      else
+        printf(1, " <2^%d:%d", b+8, s->hist[b]);
+    }
+    printf(1, "\n");
+  }
+}
+
+int
+trapgetpid(void)
+{
+  int pid;
+
+  asm volatile("int %1" : "=a" (pid) : "i" (T_SYSCALL), "0" (SYS_getpid) : "memory");
+  return pid;
+}
+
+void
+bench(int n)
+{
+  uint64 t;
+  int i;
+
+  t = rdtsc();
+  for(i = 0; i < n; i++)
+    getpid();
+  t = rdtsc() - t;
+  printf(1, "sysenter: %d cycles per getpid\n", avg(t, n));
+
+  t = rdtsc();
+  for(i = 0; i < n; i++)
+    trapgetpid();
+  t = rdtsc() - t;
+  printf(1, "int:      %d cycles per getpid\n", avg(t, n));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc > 1 && strcmp(argv[1], "-b") == 0){
+    bench(1000 * (argc > 2 ? atoi(argv[2]) : 100));
+    exit();
+  }
+
+  if(sysstat(&before) < 0){
+    printf(2, "sysstat: sysstat failed\n");
+    exit();
+  }
+  if(argc < 2){
+    report(&before);
+    exit();
+  }
+
+  if((pid = fork()) < 0){
+    printf(2, "sysstat: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    printf(2, "sysstat: exec %s failed\n", argv[1]);
+    exit();
+  }
+  wait();
+  sysstat(&after);
+  delta();
+  report(&after);
+  exit();
+}
@@ -7,6 +7,8 @@
 #include "x86.h"     // For lidt()
 #include "traps.h"   // For T_SYSCALL and trap numbers
 #include "spinlock.h"
+#include "fcntl.h"    // For PROT_WRITE
+#include "stat.h"     // For struct sysstat
 
 #define DEBUG_ALLOC 1
 #if defined(LOCALITY_ALLOCATOR)
@@ -20,6 +22,7 @@
 struct spinlock tickslock;
 uint ticks;
 struct gatedesc idt[256];
+extern void sysentry(void);  // in trapasm.S
 extern uint vectors[];  
   // vectors.S declares these
 extern pte_t* walkpgdir(pde_t *pgdir, const void *va, int alloc);
@@ -32,6 +35,13 @@ static int handle_page_fault(struct proc *curproc, uint va);
 void idtinit(void)
 {
   lidt(idt, sizeof(idt));
+
+  // System calls can also enter at sysentry with sysenter, which
+  // takes its stack from MSR_SYSENTER_ESP; switchuvm() sets that.
+  if(!(cpufeatures() & CPUID_SEP))
+    panic("idtinit: no sysenter");
+  wrmsr(MSR_SYSENTER_CS, SEG_KCODE<<3);
+  wrmsr(MSR_SYSENTER_EIP, (uint)sysentry);
 }
 
 
@@ -110,6 +120,7 @@ trap(struct trapframe *tf)
     if(tf->trapno == T_SYSCALL){
         if(myproc()->killed)
             exit();
+        sysstats.trapentries++;
         myproc()->tf = tf;
         syscall();
         if(myproc()->killed)
@@ -122,10 +133,29 @@ trap(struct trapframe *tf)
         if((tf->cs&3) == DPL_USER){  // User space fault
             uint va = rcr2();
             struct proc *curproc = myproc();
+            struct vma *v;
 
-            // Check if address is valid
-            if(va < curproc->sz && va >= PGSIZE && va < KERNBASE){
-                if(handle_page_fault(curproc, va) < 0) {
+            // A page of the program or heap not touched yet. Bit 0
+            // of the error code is set if the page was present.
+            if(!(tf->err & 1) && va < curproc->sz){
+                if(uvmfault(curproc, va) < 0) {
+                    cprintf("out of memory\n");
+                    curproc->killed = 1;
+                    break;
+                }
+                return;
+            }
+
+            // An mmap()ed page not yet touched. Bit 1 of the
+            // error code is set for a write.
+            if((v = vmalookup(curproc, va)) != 0){
+                if((tf->err & 2) && !(v->prot & PROT_WRITE)){
+                    cprintf("pid %d %s: write to read-only mapping 0x%x--kill proc\n",
+                            curproc->pid, curproc->name, va);
+                    curproc->killed = 1;
+                    break;
+                }
+                if(vmafault(curproc, v, va) < 0){
                     cprintf("out of memory\n");
                     curproc->killed = 1;
                     break;
@@ -164,6 +194,14 @@ trap(struct trapframe *tf)
             cpuid(), tf->cs, tf->eip);
     lapiceoi();
     break;
+  case T_DEBUG:
+    // sysenter leaves FL_TF alone, so a process that sets it
+    // single-steps into sysentry. Clear it and carry on.
+    if((tf->cs&3) == 0){
+      tf->eflags &= ~FL_TF;
+      return;
+    }
+    // fall through
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
       cprintf("unexpected trap %d from cpu %d eip %x (cr2=0x%x)\n",
@@ -191,9 +229,40 @@ trap(struct trapframe *tf)
     exit();
 }
 
+// sysentry in trapasm.S calls here with the trap frame it built,
+// which looks like one from int $T_SYSCALL. sysenter turned
+// interrupts off; the int path's trap gate would have left them on.
+void
+sysentertrap(struct trapframe *tf)
+{
+  sti();
+  if(myproc()->killed)
+    exit();
+  sysstats.fastentries++;
+  myproc()->tf = tf;
+  syscall();
+  if(myproc()->killed)
+    exit();
+}
 
 
 
+
+// Fill in the missing page of p holding va, below p->sz: read
+// from the program file if va is in one of its segments, else a
+// zeroed heap page from the allocator.
+int
+uvmfault(struct proc *p, uint va)
+{
+    int r;
+
+    if((r = execfault(p, va)) != 0)
+        return r < 0 ? -1 : 0;
+    if(va < PGSIZE || va >= KERNBASE)
+        return -1;
+    return handle_page_fault(p, va);
+}
+
 static int
 handle_page_fault(struct proc *curproc, uint va)
 {
@@ -4,6 +4,35 @@
 #include "user.h"
 #include "x86.h"
 
+// stdio.c points this at a function that flushes its streams,
+// which exit(), fork() and exec() call first, so that output is
+// neither lost nor written twice.
+void (*stdioflush)(void);
+
+int
+exit(void)
+{
+  if(stdioflush)
+    stdioflush();
+  _exit();
+}
+
+int
+fork(void)
+{
+  if(stdioflush)
+    stdioflush();
+  return _fork();
+}
+
+int
+exec(char *path, char **argv)
+{
+  if(stdioflush)
+    stdioflush();
+  return _exec(path, argv);
+}
+
 char*
 strcpy(char *s, const char *t)
 {
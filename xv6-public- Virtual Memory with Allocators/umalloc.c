@@ -3,88 +3,210 @@
 #include "user.h"
 #include "param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator with size classes.
+//
+// Every block starts with an 8-byte header. Requests of up to
+// SMALLMAX bytes, header included, are rounded up to a power of
+// two from 16 and served from a free list per size; an empty list
+// is refilled by bumping a pointer through a span of SPANSIZE
+// bytes. Small blocks go back on their list when freed and are
+// never merged, so malloc() and free() of them are O(1).
+//
+// Spans and bigger requests are "large" blocks, cut from memory
+// got with sbrk(). Each large block's header records its own size
+// and the size of the block before it, so free() can merge a
+// block with free neighbours on either side without a search.
+// Free large blocks are on one doubly linked list, searched first
+// fit. A region of sbrk()ed memory ends in a zero-sized, in-use
+// header that stops merges running off the end.
 
-typedef long Align;
+#define FREE     1   // in size: large block is free
+#define SMALL    2   // in size: block belongs to a size class
+#define SIZE(h)  ((h)->size & ~7)
 
-union header {
-  struct {
-    union header *ptr;
-    uint size;
-  } s;
-  Align x;
-};
+#define NCLASS   8
+#define SMALLMAX (16 << (NCLASS-1))  // 2048
+#define SPANSIZE (16*1024)
+#define MINGROW  (32*1024)
 
-typedef union header Header;
+typedef struct header {
+  uint size;      // bytes, header included, and FREE/SMALL
+  uint prev;      // large: size of the block before, 0 if none;
+                  // small: size class
+} Header;
 
-static Header base;
-static Header *freep;
+// What a free block holds after its header.
+typedef struct link {
+  struct link *next;
+  struct link *prev;  // large blocks only
+} Link;
 
-void
-free(void *ap)
+static Link *classfree[NCLASS];
+static char *bump[NCLASS], *bumpend[NCLASS];
+static Link bigfree = { &bigfree, &bigfree };
+static char *top;  // end of the last region from sbrk()
+
+#define LINK(h)   ((Link*)((h) + 1))
+#define HDR(l)    ((Header*)(l) - 1)
+#define NEXT(h)   ((Header*)((char*)(h) + SIZE(h)))
+
+static void
+bigput(Header *h)
+{
+  Link *l;
+
+  l = LINK(h);
+  l->next = bigfree.next;
+  l->prev = &bigfree;
+  bigfree.next->prev = l;
+  bigfree.next = l;
+}
+
+static void
+bigdel(Header *h)
 {
-  Header *bp, *p;
-
-  bp = (Header*)ap - 1;
-  for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
-    if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
-      break;
-  if(bp + bp->s.size == p->s.ptr){
-    bp->s.size += p->s.ptr->s.size;
-    bp->s.ptr = p->s.ptr->s.ptr;
-  } else
-    bp->s.ptr = p->s.ptr;
-  if(p + p->s.size == bp){
-    p->s.size += bp->s.size;
-    p->s.ptr = bp->s.ptr;
-  } else
-    p->s.ptr = bp;
-  freep = p;
+  Link *l;
+
+  l = LINK(h);
+  l->prev->next = l->next;
+  l->next->prev = l->prev;
 }
 
-static Header*
-morecore(uint nu)
+// Mark large block h free, merging it with free neighbours.
+static void
+bigfreeblk(Header *h)
+{
+  Header *n, *p;
+
+  h->size = SIZE(h) | FREE;
+  n = NEXT(h);
+  if(n->size & FREE){
+    bigdel(n);
+    h->size += SIZE(n);
+  }
+  if(h->prev != 0 && ((p = (Header*)((char*)h - h->prev))->size & FREE)){
+    p->size += SIZE(h);
+    h = p;
+  } else {
+    bigput(h);
+  }
+  NEXT(h)->prev = SIZE(h);
+}
+
+// Get at least n more bytes from sbrk() as a free large block.
+// Memory that directly follows the last region extends it.
+static int
+morecore(uint n)
 {
   char *p;
-  Header *hp;
+  uint grow;
+  Header *h, *end;
 
-  if(nu < 4096)
-    nu = 4096;
-  p = sbrk(nu * sizeof(Header));
-  if(p == (char*)-1)
-    return 0;
-  hp = (Header*)p;
-  hp->s.size = nu;
-  free((void*)(hp + 1));
-  return freep;
+  grow = (n + 2*sizeof(Header) + 4095) & ~4095;
+  if(grow < MINGROW)
+    grow = MINGROW;
+  if((p = sbrk(grow)) == (char*)-1){
+    grow = (n + 2*sizeof(Header) + 4095) & ~4095;
+    if((p = sbrk(grow)) == (char*)-1)
+      return -1;
+  }
+  if(top != 0 && p == top){
+    // Reuse the old end marker as the new block's header.
+    h = (Header*)p - 1;
+    h->size = grow;
+  } else {
+    h = (Header*)(((uint)p + 7) & ~7);
+    h->size = (p + grow - (char*)h - sizeof(Header)) & ~7;
+    h->prev = 0;
+  }
+  end = NEXT(h);
+  end->size = 0;
+  top = (char*)(end + 1) == p + grow ? p + grow : 0;
+  bigfreeblk(h);
+  return 0;
+}
+
+// A large block of exactly n bytes, header included, n a
+// multiple of 8.
+static Header*
+bigalloc(uint n)
+{
+  Link *l;
+  Header *h, *r;
+
+  for(;;){
+    for(l = bigfree.next; l != &bigfree; l = l->next){
+      h = HDR(l);
+      if(SIZE(h) < n)
+        continue;
+      bigdel(h);
+      if(SIZE(h) - n >= 64){
+        r = (Header*)((char*)h + n);
+        r->size = SIZE(h) - n;
+        r->prev = n;
+        NEXT(r)->prev = SIZE(r);
+        bigput(r);
+        r->size |= FREE;
+        h->size = n;
+      } else {
+        h->size = SIZE(h);
+      }
+      return h;
+    }
+    if(morecore(n) < 0)
+      return 0;
+  }
 }
 
 void*
 malloc(uint nbytes)
 {
-  Header *p, *prevp;
-  uint nunits;
+  uint n, c;
+  Header *h;
+  Link *l;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
-  if((prevp = freep) == 0){
-    base.s.ptr = freep = prevp = &base;
-    base.s.size = 0;
+  if(nbytes > 0x7fff0000)
+    return 0;
+  n = nbytes + sizeof(Header);
+  if(n > SMALLMAX){
+    if((h = bigalloc((n + 7) & ~7)) == 0)
+      return 0;
+    return h + 1;
   }
-  for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
-    if(p->s.size >= nunits){
-      if(p->s.size == nunits)
-        prevp->s.ptr = p->s.ptr;
-      else {
-        p->s.size -= nunits;
-        p += p->s.size;
-        p->s.size = nunits;
-      }
-      freep = prevp;
-      return (void*)(p + 1);
-    }
-    if(p == freep)
-      if((p = morecore(nunits)) == 0)
-        return 0;
+
+  for(c = 0; (16 << c) < n; c++)
+    ;
+  if((l = classfree[c]) != 0){
+    classfree[c] = l->next;
+    return l;
+  }
+  if(bumpend[c] - bump[c] < (16 << c)){
+    if((h = bigalloc(SPANSIZE)) == 0)
+      return 0;
+    bump[c] = (char*)(h + 1);
+    bumpend[c] = (char*)h + SPANSIZE;
+  }
+  h = (Header*)bump[c];
+  bump[c] += 16 << c;
+  h->size = (16 << c) | SMALL;
+  h->prev = c;
+  return h + 1;
+}
+
+void
+free(void *ap)
+{
+  Header *h;
+  Link *l;
+
+  if(ap == 0)
+    return;
+  h = (Header*)ap - 1;
+  if(h->size & SMALL){
+    l = ap;
+    l->next = classfree[h->prev];
+    classfree[h->prev] = l;
+    return;
   }
+  bigfreeblk(h);
 }
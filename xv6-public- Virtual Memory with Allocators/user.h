@@ -1,16 +1,20 @@
 struct stat;
+struct fsstat;
+struct sysstat;
+struct spawnact;
+struct iovec;
 struct rtcdate;
 
 // system calls
-int fork(void);
-int exit(void) __attribute__((noreturn));
+int _fork(void);
+int _exit(void) __attribute__((noreturn));
 int wait(void);
 int pipe(int*);
 int write(int, const void*, int);
 int read(int, void*, int);
 int close(int);
 int kill(int);
-int exec(char*, char**);
+int _exec(char*, char**);
 int open(const char*, int);
 int mknod(const char*, short, short);
 int unlink(const char*);
@@ -23,19 +27,57 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
-int lseek(int fd, int offset);
+int lseek(int fd, int offset, int whence);
 int symlink(const char*, const char*);
+int fsstat(struct fsstat*);
+int pread(int, void*, int, int);
+int pwrite(int, const void*, int, int);
+int readv(int, struct iovec*, int);
+int writev(int, struct iovec*, int);
+void* mmap(void*, int, int, int, int, int);
+int munmap(void*, int);
+int sendfile(int, int, int, int);
+int fcntl(int, int, int);
+int sysstat(struct sysstat*);
+int spawn(char*, char**, struct spawnact*, int);
 
 // ulib.c
+extern void (*stdioflush)(void);
+int fork(void);
+int exit(void) __attribute__((noreturn));
+int exec(char*, char**);
 int stat(const char*, struct stat*);
 char* strcpy(char*, const char*);
 void *memmove(void*, const void*, int);
 char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
-void printf(int, const char*, ...);
 char* gets(char*, int max);
 uint strlen(const char*);
 void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
+
+// stdio.c
+#define BUFSIZ 512
+#define _IOFBF 1  // flush when the buffer is full
+#define _IOLBF 2  // ... or at a newline
+#define _IONBF 3  // ... or at the end of every call
+struct stream {
+  int fd;
+  int mode;     // _IO*BF, or 0 until first use
+  int rd;       // an input stream
+  char *buf;
+  int size;
+  int n;        // bytes in buf
+  int pos;      // input: next byte of buf to return
+  int err;      // a write failed
+};
+extern struct stream *stdin, *stdout, *stderr;
+void printf(int, const char*, ...);
+int fprintf(struct stream*, const char*, ...);
+int fputc(int, struct stream*);
+int fputs(const char*, struct stream*);
+int fgetc(struct stream*);
+char* fgets(char*, int, struct stream*);
+int fflush(struct stream*);
@@ -6,6 +6,11 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
@@ -149,6 +154,7 @@ switchuvm(struct proc *p)
   mycpu()->gdt[SEG_TSS].s = 0;
   mycpu()->ts.ss0 = SEG_KDATA << 3;
   mycpu()->ts.esp0 = (uint)p->kstack + KSTACKSIZE;
+  wrmsr(MSR_SYSENTER_ESP, (uint)p->kstack + KSTACKSIZE);
   // setting IOPL=0 in eflags *and* iomb beyond the tss segment limit
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
@@ -291,7 +297,8 @@ clearpteu(pde_t *pgdir, char *uva)
 }
 
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child. Pages the parent has not touched yet are
+// left for the child to fault in too.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
@@ -303,10 +310,12 @@ copyuvm(pde_t *pgdir, uint sz)
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
     if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+      continue;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
     if((mem = kalloc()) == 0)
@@ -365,6 +374,309 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
   return 0;
 }
 
+//PAGEBREAK!
+// Demand-paged programs.
+//
+// exec() records the program's loadable segments in p->seg and
+// keeps a reference to its file in p->exe; it maps none of them.
+// The first touch of a page faults, and execfault() reads it in.
+
+// If va is in one of p's program segments, allocate and map its
+// page, read from the program file where the segment has file
+// data and zero past that. Returns 1 if it did, 0 if va is in no
+// segment, or -1 if out of memory or the read fails.
+int
+execfault(struct proc *p, uint va)
+{
+  struct execseg *s;
+  char *mem;
+  uint a, n;
+
+  for(s = p->seg; s < &p->seg[p->nseg]; s++)
+    if(va >= s->va && va < PGROUNDUP(s->va + s->memsz))
+      break;
+  if(s == &p->seg[p->nseg])
+    return 0;
+
+  a = PGROUNDDOWN(va);
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(a < s->va + s->filesz){
+    n = s->va + s->filesz - a;
+    if(n > PGSIZE)
+      n = PGSIZE;
+    ilock(p->exe);
+    if(readi(p->exe, mem, s->off + (a - s->va), n) != n){
+      iunlock(p->exe);
+      kfree(mem);
+      return -1;
+    }
+    iunlock(p->exe);
+  }
+  if(mappages(p->pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 1;
+}
+
+// Fault in the untouched pages of [va, va+n) below p->sz, so that
+// a system call can use them.
+int
+uvmtouch(struct proc *p, uint va, uint n)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + n && a < p->sz; a += PGSIZE){
+    pte = walkpgdir(p->pgdir, (char*)a, 0);
+    if((!pte || !(*pte & PTE_P)) && uvmfault(p, a) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+//PAGEBREAK!
+// Memory-mapped regions.
+//
+// mmap() only records a region in p->vma[]. Its pages are
+// allocated by vmafault() when first touched, and filled from
+// the file for a file mapping. Dirty pages of a MAP_SHARED file
+// mapping are written back when they are unmapped, by munmap(),
+// exit() or exec(). A fork()ed child gets its own copy of every
+// page, so MAP_SHARED shares with the file, not between parent
+// and child.
+
+// The region of p holding va, or 0.
+struct vma*
+vmalookup(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->start && va >= v->start && va < v->end)
+      return v;
+  return 0;
+}
+
+// Does any region of p overlap [start, end)?
+int
+vmaoverlap(struct proc *p, uint start, uint end)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->start && start < v->end && v->start < end)
+      return 1;
+  return 0;
+}
+
+// Allocate and map the page of region v holding va.
+int
+vmafault(struct proc *p, struct vma *v, uint va)
+{
+  char *mem;
+  uint a;
+
+  a = PGROUNDDOWN(va);
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(v->f){
+    // Past the end of the file the page stays zero.
+    ilock(v->f->ip);
+    readi(v->f->ip, mem, v->off + (a - v->start), PGSIZE);
+    iunlock(v->f->ip);
+  }
+  if(mappages(p->pgdir, (char*)a, PGSIZE, V2P(mem),
+              PTE_U | ((v->prot & PROT_WRITE) ? PTE_W : 0)) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
+// Fault in the untouched pages of [va, va+n), which must lie in
+// a single region of p, so that a system call can use them as a
+// buffer. Returns -1 if they do not.
+int
+vmatouch(struct proc *p, uint va, uint n)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint a;
+
+  if((v = vmalookup(p, va)) == 0 || va + n > v->end || va + n < va)
+    return -1;
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    pte = walkpgdir(p->pgdir, (char*)a, 0);
+    if((!pte || !(*pte & PTE_P)) && vmafault(p, v, a) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Add a region of len bytes to p, below MMAPTOP and above the
+// heap, and return its address, or 0 if there is no room.
+// Takes over the caller's reference to f.
+int
+vmamap(struct proc *p, uint len, int prot, int flags, struct file *f, uint off)
+{
+  struct vma *v, *free;
+  uint end;
+
+  len = PGROUNDUP(len);
+  free = 0;
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->start == 0 && free == 0)
+      free = v;
+  if(free == 0)
+    return 0;
+
+  // Highest gap that fits.
+  end = MMAPTOP;
+  for(;;){
+    if(end < len || end - len < PGROUNDUP(p->sz))
+      return 0;
+    for(v = p->vma; v < &p->vma[NVMA]; v++)
+      if(v->start && end - len < v->end && v->start < end)
+        break;
+    if(v == &p->vma[NVMA])
+      break;
+    end = v->start;
+  }
+
+  free->start = end - len;
+  free->end = end;
+  free->prot = prot;
+  free->flags = flags;
+  free->f = f;
+  free->off = off;
+  return free->start;
+}
+
+// Write back the page at a of region v if it is a dirty page of
+// a shared file mapping; never extends the file.
+static void
+vmawriteback(struct vma *v, uint a, pte_t pte)
+{
+  uint off, size, n;
+
+  if(v->f == 0 || !(v->flags & MAP_SHARED) || !(pte & PTE_D))
+    return;
+  off = v->off + (a - v->start);
+  ilock(v->f->ip);
+  size = v->f->ip->size;
+  iunlock(v->f->ip);
+  if(off >= size)
+    return;
+  n = size - off < PGSIZE ? size - off : PGSIZE;
+  filepwrite(v->f, P2V(PTE_ADDR(pte)), n, off);
+}
+
+// Write back and free the pages of region v in [a, b).
+static void
+vmafree(struct proc *p, struct vma *v, uint a, uint b)
+{
+  pte_t *pte;
+
+  for(; a < b; a += PGSIZE){
+    pte = walkpgdir(p->pgdir, (char*)a, 0);
+    if(!pte)
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    else if(*pte & PTE_P){
+      vmawriteback(v, a, *pte);
+      kfree(P2V(PTE_ADDR(*pte)));
+      *pte = 0;
+    }
+  }
+}
+
+// Unmap [start, end) from p, which may cut regions in two.
+// Returns -1, changing nothing, if that needs more than NVMA.
+int
+vmaunmap(struct proc *p, uint start, uint end)
+{
+  struct vma *v, *nv;
+
+  nv = 0;
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->start && v->start < start && end < v->end){
+      for(nv = p->vma; nv < &p->vma[NVMA] && nv->start; nv++)
+        ;
+      if(nv == &p->vma[NVMA])
+        return -1;
+      *nv = *v;
+      nv->start = end;
+      nv->off += end - v->start;
+      nv->f = nv->f ? filedup(nv->f) : 0;
+      v->end = end;
+    }
+  }
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->start == 0 || end <= v->start || v->end <= start)
+      continue;
+    if(start <= v->start && v->end <= end){
+      vmafree(p, v, v->start, v->end);
+      if(v->f)
+        fileclose(v->f);
+      v->start = 0;
+    } else if(start <= v->start){
+      vmafree(p, v, v->start, end);
+      v->off += end - v->start;
+      v->start = end;
+    } else {
+      vmafree(p, v, start, v->end);
+      v->end = start;
+    }
+  }
+  if(p == myproc())
+    lcr3(V2P(p->pgdir));  // flush the TLB
+  return 0;
+}
+
+// Give child np a copy of each of p's regions and their pages.
+int
+vmacopy(struct proc *np, struct proc *p)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint a;
+  char *mem;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->start == 0)
+      continue;
+    np->vma[v - p->vma] = *v;
+    if(v->f)
+      filedup(v->f);
+    for(a = v->start; a < v->end; a += PGSIZE){
+      pte = walkpgdir(p->pgdir, (char*)a, 0);
+      if(!pte || !(*pte & PTE_P))
+        continue;
+      if((mem = kalloc()) == 0)
+        return -1;
+      memmove(mem, P2V(PTE_ADDR(*pte)), PGSIZE);
+      // The child writes back only what it changes itself.
+      if(mappages(np->pgdir, (char*)a, PGSIZE, V2P(mem),
+                  PTE_FLAGS(*pte) & ~PTE_D) < 0){
+        kfree(mem);
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+// Unmap all of p's regions, writing back dirty shared pages.
+void
+vmaclear(struct proc *p)
+{
+  vmaunmap(p, 0, MMAPTOP);
+}
+
 //PAGEBREAK!
 // Blank page.
 //PAGEBREAK!
@@ -130,6 +130,38 @@ xchg(volatile uint *addr, uint newval)
   return result;
 }
 
+// Model-specific registers for sysenter.
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+// CPUID leaf 1 feature bits in %edx.
+#define CPUID_SEP        (1<<11)  // sysenter and sysexit
+
+static inline void
+wrmsr(uint msr, uint val)
+{
+  asm volatile("wrmsr" : : "c" (msr), "a" (val), "d" (0));
+}
+
+// Feature bits in %edx from CPUID leaf 1.
+static inline uint
+cpufeatures(void)
+{
+  uint a, b, c, d;
+
+  asm volatile("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (1));
+  return d;
+}
+
+static inline uint64
+rdtsc(void)
+{
+  uint64 val;
+  asm volatile("rdtsc" : "=A" (val));
+  return val;
+}
+
 static inline uint
 rcr2(void)
 {
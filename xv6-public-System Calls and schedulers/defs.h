@@ -1,5 +1,6 @@
 struct buf;
 struct context;
+struct dirrec;
 struct file;
 struct inode;
 struct pipe;
@@ -37,6 +38,7 @@ int             filewrite(struct file*, char*, int n);
 // fs.c
 void            readsb(int dev, struct superblock *sb);
 int             dirlink(struct inode*, char*, uint);
+int             dirread(struct inode*, uint*, struct dirrec*, int);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
@@ -0,0 +1,149 @@
+// Directory listing cost: make a directory of files, then list it
+// with each entry's type and size the old way, a read() per entry
+// and a stat() of each name, and with getdents(). Prints the
+// system calls per listing and the ticks for all rounds of each.
+//
+//   dirbench [files] [rounds]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+
+#define DIR "dirbench.d"
+
+char path[64];
+int nsys;  // system calls made by the listing
+
+// Set path to DIR's ith file, or to name within DIR.
+void
+mkpath(int i, char *name)
+{
+  char *p;
+
+  strcpy(path, DIR "/");
+  p = path + strlen(path);
+  if(name != 0){
+    strcpy(p, name);
+    return;
+  }
+  *p++ = 'f';
+  *p++ = '0' + i / 100 % 10;
+  *p++ = '0' + i / 10 % 10;
+  *p++ = '0' + i % 10;
+  *p = 0;
+}
+
+uint
+readstat(void)
+{
+  struct dirent de;
+  struct stat st;
+  char name[DIRSIZ+1];
+  uint sum;
+  int fd;
+
+  sum = 0;
+  fd = open(DIR, O_RDONLY);
+  nsys++;
+  for(;;){
+    nsys++;
+    if(read(fd, &de, sizeof(de)) != sizeof(de))
+      break;
+    if(de.inum == 0)
+      continue;
+    memmove(name, de.name, DIRSIZ);
+    name[DIRSIZ] = 0;
+    mkpath(0, name);
+    nsys += 3;  // open, fstat, close
+    if(stat(path, &st) == 0)
+      sum += st.type + st.size;
+  }
+  close(fd);
+  nsys++;
+  return sum;
+}
+
+uint
+dents(void)
+{
+  struct dirrec d[32];
+  struct stat st;
+  uint sum;
+  int fd, i, n;
+
+  sum = 0;
+  fd = open(DIR, O_RDONLY);
+  nsys++;
+  for(;;){
+    nsys++;
+    if((n = getdents(fd, d, sizeof(d)/sizeof(d[0]))) <= 0)
+      break;
+    for(i = 0; i < n; i++){
+      if(d[i].type == 0){  // ".."
+        mkpath(0, d[i].name);
+        nsys += 3;
+        if(stat(path, &st) == 0)
+          sum += st.type + st.size;
+      } else
+        sum += d[i].type + d[i].size;
+    }
+  }
+  close(fd);
+  nsys++;
+  return sum;
+}
+
+void
+run(char *name, uint (*list)(void), int rounds)
+{
+  int i, t;
+  uint sum;
+
+  nsys = 0;
+  sum = 0;
+  t = uptime();
+  for(i = 0; i < rounds; i++)
+    sum += list();
+  t = uptime() - t;
+  printf(1, "%s: %d system calls per listing, %d ticks for %d (check %d)\n",
+         name, nsys / rounds, t, rounds, sum / rounds);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, rounds, i, fd;
+
+  n = argc > 1 ? atoi(argv[1]) : 1000;
+  rounds = argc > 2 ? atoi(argv[2]) : 20;
+  if(n > 1000)
+    n = 1000;  // f000 to f999
+
+  if(mkdir(DIR) < 0){
+    printf(1, "dirbench: cannot create %s\n", DIR);
+    exit();
+  }
+  for(i = 0; i < n; i++){
+    mkpath(i, 0);
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+      printf(1, "dirbench: cannot create %s\n", path);
+      n = i;
+      break;
+    }
+    write(fd, path, i % 64);
+    close(fd);
+  }
+  printf(1, "%d files\n", n);
+
+  run("read+stat", readstat, rounds);
+  run("getdents ", dents, rounds);
+
+  for(i = 0; i < n; i++){
+    mkpath(i, 0);
+    unlink(path);
+  }
+  unlink(DIR);
+  exit();
+}
@@ -1,84 +1,227 @@
+// find: walk a tree reading each directory with getdents(), which
+// gives every entry's type, so nothing needs a stat(). A whole
+// directory is read and closed before find descends into it, and
+// output lines are collected into one write().
+//
+// With -j n, n worker processes walk the subtrees under the top
+// directory, taking them from a pipe as struct dirents, so their
+// I/O waits overlap. Output lines are then in no particular order.
+
 #include "types.h"
 #include "stat.h"
 #include "user.h"
 #include "fs.h"
 
+#define MAXPATH 512
+#define NBATCH  32  // entries per getdents() at first
+
+char path[MAXPATH];
+char *name;
+char type;
+int inum;
+char inum_op = '=';
+int printi;
+
+char obuf[512];
+int nobuf;
+
 void
-find(char *path, char *name, char type, int inum, char inum_op, int printi)
+flush(void)
+{
+  if(nobuf > 0)
+    write(1, obuf, nobuf);
+  nobuf = 0;
+}
+
+// Print path[0..len) if it passes the tests. ino and t are its
+// inode number and type.
+void
+report(int len, int ino, int t)
+{
+  char num[12];
+  int i, n;
+
+  if(!((t == T_FILE && type != 'd') || (t == T_DIR && type == 'd')))
+    return;
+  if(name != 0){
+    n = strlen(name);
+    if(n > len || strcmp(path + len - n, name) != 0)
+      return;
+  }
+  if(inum != 0 &&
+     !(inum_op == '=' && ino == inum) &&
+     !(inum_op == '+' && ino > inum) &&
+     !(inum_op == '-' && ino < inum))
+    return;
+
+  i = sizeof(num);
+  if(printi){
+    num[--i] = ' ';
+    do
+      num[--i] = '0' + ino % 10;
+    while((ino /= 10) > 0);
+  }
+  n = sizeof(num) - i;
+  if(nobuf + n + len + 1 > sizeof(obuf))
+    flush();
+  memmove(obuf + nobuf, num + i, n);
+  memmove(obuf + nobuf + n, path, len);
+  nobuf += n + len;
+  obuf[nobuf++] = '\n';
+}
+
+// Read all of the entries of directory fd into a malloc()ed
+// array, setting *np to their number.
+struct dirrec*
+readents(int fd, int *np)
 {
-  char buf[512], *p;
+  struct dirrec *d, *nd;
+  int n, m, cap;
+
+  n = 0;
+  cap = NBATCH;
+  d = malloc(cap * sizeof(*d));
+  while(d != 0 && (m = getdents(fd, d + n, cap - n)) > 0){
+    n += m;
+    if(n == cap){
+      nd = malloc(2 * cap * sizeof(*d));
+      if(nd != 0)
+        memmove(nd, d, n * sizeof(*d));
+      free(d);
+      d = nd;
+      cap *= 2;
+    }
+  }
+  *np = n;
+  return d;
+}
+
+// Open and read directory path[0..len), and check that its
+// entries' paths will fit.
+struct dirrec*
+loaddir(int len, int *np)
+{
+  struct dirrec *d;
   int fd;
-  struct dirent de;
-  struct stat st;
 
+  if(len + 1 + DIRSIZ + 1 > MAXPATH){
+    flush();
+    printf(1, "find: path too long\n");
+    return 0;
+  }
   if((fd = open(path, 0)) < 0)
+    return 0;
+  d = readents(fd, np);
+  close(fd);
+  if(d == 0){
+    flush();
+    printf(1, "find: cannot read %s\n", path);
+  }
+  return d;
+}
+
+int
+dots(char *s)
+{
+  return strcmp(s, ".") == 0 || strcmp(s, "..") == 0;
+}
+
+void visit(int, int, int);
+
+// Visit the entries of directory path[0..len), and below.
+void
+walk(int len)
+{
+  struct dirrec *d;
+  int i, n;
+
+  if((d = loaddir(len, &n)) == 0)
     return;
+  path[len] = '/';
+  for(i = 0; i < n; i++){
+    if(dots(d[i].name))
+      continue;
+    strcpy(path + len + 1, d[i].name);
+    visit(len + 1 + strlen(d[i].name), d[i].inum, d[i].type);
+  }
+  path[len] = 0;
+  free(d);
+}
 
-  if(fstat(fd, &st) < 0){
-    close(fd);
+// Visit path[0..len), with inode number ino and type t.
+void
+visit(int len, int ino, int t)
+{
+  report(len, ino, t);
+  if(t == T_DIR)
+    walk(len);
+}
+
+// Visit directory path[0..len) with nworker processes, which
+// take its subdirectories from a pipe and walk them.
+void
+fanout(int len, int ino, int nworker)
+{
+  struct dirrec *d;
+  struct dirent de;
+  int q[2], i, n, pid;
+
+  report(len, ino, T_DIR);
+  if((d = loaddir(len, &n)) == 0)
+    return;
+  if(pipe(q) < 0){
+    free(d);
+    walk(len);
     return;
   }
+  flush();  // or each worker would print it again
 
-  switch(st.type){
-  case T_FILE:
-    if(type == 0 || type == 'f'){
-      if(name == 0 || strcmp(path + strlen(path) - strlen(name), name) == 0) {
-        if(inum == 0 || 
-          (inum_op == '=' && st.ino == inum) ||
-          (inum_op == '+' && st.ino > inum) ||
-          (inum_op == '-' && st.ino < inum)) {
-          if(printi)
-            printf(1, "%d ", st.ino);
-          printf(1, "%s\n", path);
-        }
-      }
-    }
-    break;
-
-  case T_DIR:
-    if(type == 'd' && (name == 0 || strcmp(path + strlen(path) - strlen(name), name) == 0)) {
-      if(inum == 0 || 
-        (inum_op == '=' && st.ino == inum) ||
-        (inum_op == '+' && st.ino > inum) ||
-        (inum_op == '-' && st.ino < inum)) {
-        if(printi)
-          printf(1, "%d ", st.ino);
-        printf(1, "%s\n", path);
-      }
-    }
-    if(strlen(path) + 1 + DIRSIZ + 1 > sizeof buf){
-      printf(1, "find: path too long\n");
+  // A pipe holds a whole number of struct dirents, so the writer
+  // never sleeps part way through one and a reader never sees half.
+  path[len] = '/';
+  for(i = 0; i < nworker; i++){
+    if((pid = fork()) < 0)
       break;
+    if(pid == 0){
+      close(q[1]);
+      while(read(q[0], &de, sizeof(de)) == sizeof(de)){
+        memmove(path + len + 1, de.name, DIRSIZ);
+        path[len + 1 + DIRSIZ] = 0;
+        visit(len + 1 + strlen(path + len + 1), de.inum, T_DIR);
+      }
+      flush();
+      exit();
     }
-    strcpy(buf, path);
-    p = buf+strlen(buf);
-    *p++ = '/';
-    while(read(fd, &de, sizeof(de)) == sizeof(de)){
-      if(de.inum == 0)
-        continue;
-      memmove(p, de.name, DIRSIZ);
-      p[DIRSIZ] = 0;
-      if(stat(buf, &st) < 0){
-        printf(1, "find: cannot stat %s\n", buf);
+  }
+  nworker = i;
+  close(q[0]);
+
+  for(i = 0; i < n; i++){
+    if(dots(d[i].name))
+      continue;
+    if(d[i].type == T_DIR && nworker > 0){
+      de.inum = d[i].inum;
+      memmove(de.name, d[i].name, DIRSIZ);
+      if(write(q[1], &de, sizeof(de)) == sizeof(de))
         continue;
-      }
-      if(strcmp(de.name, ".") != 0 && strcmp(de.name, "..") != 0)
-        find(buf, name, type, inum, inum_op, printi);
     }
-    break;
+    strcpy(path + len + 1, d[i].name);
+    visit(len + 1 + strlen(d[i].name), d[i].inum, d[i].type);
   }
-  close(fd);
+  path[len] = 0;
+  close(q[1]);
+  free(d);
+  flush();
+  for(i = 0; i < nworker; i++)
+    wait();
 }
 
 int
 main(int argc, char *argv[])
 {
-  char *path = ".";
-  char *name = 0;
-  char type = 0;
-  int inum = 0;
-  char inum_op = '=';
-  int printi = 0;
+  char *root = ".";
+  int nworker = 0;
+  struct stat st;
   int i;
 
   for(i = 1; i < argc; i++){
@@ -110,14 +253,32 @@ main(int argc, char *argv[])
       }
     } else if(strcmp(argv[i], "-printi") == 0){
       printi = 1;
-    } else if(path == ".") {
-      path = argv[i];
+    } else if(strcmp(argv[i], "-j") == 0){
+      if(++i < argc)
+        nworker = atoi(argv[i]);
+      else {
+        printf(2, "find: missing argument to -j\n");
+        exit();
+      }
+    } else if(root == ".") {
+      root = argv[i];
     } else {
-      printf(2, "Usage: find <path> -name <name> [-type f|d] [-inum [+-]<number>] [-printi]\n");
+      printf(2, "Usage: find <path> -name <name> [-type f|d] [-inum [+-]<number>] [-printi] [-j <workers>]\n");
       exit();
     }
   }
 
-  find(path, name, type, inum, inum_op, printi);
+  if(strlen(root) + 1 > MAXPATH){
+    printf(1, "find: path too long\n");
+    exit();
+  }
+  strcpy(path, root);
+  if(stat(path, &st) < 0)
+    exit();
+  if(st.type == T_DIR && nworker > 1)
+    fanout(strlen(path), st.ino, nworker);
+  else
+    visit(strlen(path), st.ino, st.type);
+  flush();
   exit();
-}
\ No newline at end of file
+}
@@ -577,6 +577,44 @@ dirlink(struct inode *dp, char *name, uint inum)
   return 0;
 }
 
+// Read up to n entries of directory dp from *poff on into dr,
+// with their inodes' types and sizes, moving *poff past them.
+// Returns the number of entries. Caller must hold dp's lock, and
+// be in a transaction, as it may iput() an entry's inode.
+int
+dirread(struct inode *dp, uint *poff, struct dirrec *dr, int n)
+{
+  struct dirent de;
+  struct inode *ip;
+  int k;
+
+  for(k = 0; k < n && *poff < dp->size; *poff += sizeof(de)){
+    if(readi(dp, (char*)&de, *poff, sizeof(de)) != sizeof(de))
+      panic("dirread read");
+    if(de.inum == 0)
+      continue;
+    dr[k].inum = de.inum;
+    memmove(dr[k].name, de.name, DIRSIZ);
+    dr[k].name[DIRSIZ] = 0;
+    if(namecmp(de.name, ".") == 0){
+      dr[k].type = dp->type;
+      dr[k].size = dp->size;
+    } else if(namecmp(de.name, "..") == 0){
+      // Locking dp's parent while holding dp could deadlock.
+      dr[k].type = 0;
+      dr[k].size = 0;
+    } else {
+      ip = iget(dp->dev, de.inum);
+      ilock(ip);
+      dr[k].type = ip->type;
+      dr[k].size = ip->size;
+      iunlockput(ip);
+    }
+    k++;
+  }
+  return k;
+}
+
 //PAGEBREAK!
 // Paths
 
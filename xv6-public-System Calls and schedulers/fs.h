@@ -55,3 +55,12 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// A directory entry as getdents() returns it, with its inode's
+// type and size. Those of ".." are not read: type is 0.
+struct dirrec {
+  ushort inum;
+  short type;           // T_DIR, T_FILE, T_DEV, or 0 for ".."
+  uint size;
+  char name[DIRSIZ+1];  // nul-terminated
+};
+
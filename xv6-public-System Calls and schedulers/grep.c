@@ -10,27 +10,14 @@ int match(char*, char*);
 void
 grep(char *pattern, int fd)
 {
-  int n, m;
-  char *p, *q;
+  int n;
 
-  m = 0;
-  while((n = read(fd, buf+m, sizeof(buf)-m-1)) > 0){
-    m += n;
-    buf[m] = '\0';
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){
-      *q = 0;
-      if(match(pattern, p)){
-        *q = '\n';
-        write(1, p, q+1 - p);
-      }
-      p = q+1;
-    }
-    if(p == buf)
-      m = 0;
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
+  while((n = readline(fd, buf, sizeof(buf))) > 0){
+    if(buf[n-1] == '\n')
+      buf[--n] = '\0';
+    if(match(pattern, buf)){
+      buf[n] = '\n';
+      write(1, buf, n+1);
     }
   }
 }
@@ -58,6 +45,7 @@ main(int argc, char *argv[])
       exit();
     }
     grep(pattern, fd);
+    rlclose(fd);
     close(fd);
   }
   exit();
@@ -3,6 +3,45 @@
 #include "user.h"
 #include "fs.h"
 
+char obuf[512];
+int nobuf;
+
+void
+flush(void)
+{
+  if(nobuf > 0)
+    write(1, obuf, nobuf);
+  nobuf = 0;
+}
+
+// Add the line "name type ino size" to the output.
+void
+line(char *name, int type, int ino, uint size)
+{
+  char num[3][12];
+  int len[3], i, j;
+  uint x;
+
+  for(i = 0; i < 3; i++){
+    x = i == 0 ? type : i == 1 ? ino : size;
+    j = sizeof(num[i]);
+    do
+      num[i][--j] = '0' + x % 10;
+    while((x /= 10) > 0);
+    len[i] = sizeof(num[i]) - j;
+    memmove(num[i], num[i] + j, len[i]);
+  }
+  if(nobuf + DIRSIZ + len[0] + len[1] + len[2] + 4 > sizeof(obuf))
+    flush();
+  memmove(obuf + nobuf, name, DIRSIZ);
+  nobuf += DIRSIZ;
+  for(i = 0; i < 3; i++){
+    obuf[nobuf++] = ' ';
+    memmove(obuf + nobuf, num[i], len[i]);
+    nobuf += len[i];
+  }
+  obuf[nobuf++] = '\n';
+}
 
 char*
 fmtname(char *path, int is_dir)
@@ -33,8 +72,8 @@ void
 ls(char *path, int flag)
 {
   char buf[512], *p;
-  int fd;
-  struct dirent de;
+  int fd, i, n;
+  struct dirrec d[16];
   struct stat st;
 
   if((fd = open(path, 0)) < 0){
@@ -50,7 +89,7 @@ ls(char *path, int flag)
 
   switch(st.type){
     case T_FILE:
-      printf(1, "%s %d %d %d\n", fmtname(path, 0), st.type, st.ino, st.size);
+      line(fmtname(path, 0), st.type, st.ino, st.size);
       break;
 
     case T_DIR:
@@ -62,26 +101,32 @@ ls(char *path, int flag)
       p = buf + strlen(buf);
       *p++ = '/';
 
-    while(read(fd, &de, sizeof(de)) == sizeof(de)){
-      if(de.inum == 0)
-        continue;
-
-      if(!flag && de.name[0] == '.')
-        continue;
-
-      memmove(p, de.name, DIRSIZ);
-      p[DIRSIZ] = 0;
-
-      if(stat(buf, &st) < 0){
-        printf(1, "ls: cannot stat %s\n", buf);
-        continue;
+    // getdents() gives each entry's type and size, so only ".."
+    // needs a stat().
+    while((n = getdents(fd, d, sizeof(d)/sizeof(d[0]))) > 0){
+      for(i = 0; i < n; i++){
+        if(!flag && d[i].name[0] == '.')
+          continue;
+
+        strcpy(p, d[i].name);
+
+        if(d[i].type == 0){
+          if(stat(buf, &st) < 0){
+            flush();
+            printf(1, "ls: cannot stat %s\n", buf);
+            continue;
+          }
+          d[i].type = st.type;
+          d[i].size = st.size;
+        }
+
+        line(fmtname(buf, d[i].type == T_DIR), d[i].type, d[i].inum, d[i].size);
       }
-
-      printf(1, "%s %d %d %d\n", fmtname(buf, st.type == T_DIR), st.type, st.ino, st.size);
     }
     break;
     
   }
+  flush();
   close(fd);
 }
 
@@ -108,6 +108,7 @@ extern int sys_ticks_running(void);
 extern int sys_sjf_job_length(void);
 extern int sys_set_lottery_tickets(void);
 extern int sys_get_lottery_tickets(void);
+extern int sys_getdents(void);
 
 
 
@@ -140,6 +141,7 @@ static int (*syscalls[])(void) = {
 [SYS_sjf_job_length] sys_sjf_job_length,
 [SYS_set_lottery_tickets] sys_set_lottery_tickets,
 [SYS_get_lottery_tickets] sys_get_lottery_tickets,
+[SYS_getdents] sys_getdents,
 };
 
 void
@@ -25,3 +25,4 @@
 #define SYS_sjf_job_length  24
 #define SYS_set_lottery_tickets 25
 #define SYS_get_lottery_tickets 26
+#define SYS_getdents 27
@@ -114,6 +114,38 @@ sys_fstat(void)
   return filestat(f, st);
 }
 
+// getdents(fd, buf, n) reads up to n entries of the directory
+// open as fd into buf, with their types and sizes, and moves the
+// offset past them. Returns the number of entries, 0 at the end.
+int
+sys_getdents(void)
+{
+  struct file *f;
+  struct dirrec *dr;
+  struct inode *dp;
+  int n, k;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 ||
+     n < 0 || n > 0x7fffffff / sizeof(*dr) ||
+     argptr(1, (void*)&dr, n * sizeof(*dr)) < 0)
+    return -1;
+  if(f->type != FD_INODE || !f->readable)
+    return -1;
+  dp = f->ip;
+
+  begin_op();  // dirread() may iput()
+  ilock(dp);
+  if(dp->type != T_DIR){
+    iunlock(dp);
+    end_op();
+    return -1;
+  }
+  k = dirread(dp, &f->off, dr, n);
+  iunlock(dp);
+  end_op();
+  return k;
+}
+
 // Create the path new as a link to the same inode as old.
 int
 sys_link(void)
@@ -49,21 +49,85 @@ strchr(const char *s, char c)
   return 0;
 }
 
-char*
-gets(char *buf, int max)
+// readline() reads ahead into one of these for each fd with
+// unread bytes. A buffer with none left is free for any fd.
+#define NRLBUF 4
+
+static struct rlbuf {
+  int fd;
+  int pos, n;  // unread bytes are buf[pos..n)
+  char buf[512];
+} rlbuf[NRLBUF];
+
+// Read a line from fd into buf, newline included, stopping short
+// after max-1 bytes or at end of file, and nul-terminate it.
+// Returns the number of bytes stored, 0 at end of file, or -1.
+// Reads ahead a buffer at a time, so don't mix read() and
+// readline() on one fd. Bytes still buffered when a program
+// stops reading an fd stay tagged with its number, and a file
+// opened later with that number would get them: call rlclose()
+// before closing it. If every buffer holds another fd's bytes,
+// reads one byte at a time.
+int
+readline(int fd, char *buf, int max)
 {
-  int i, cc;
+  struct rlbuf *b, *empty;
+  int i, n;
   char c;
 
-  for(i=0; i+1 < max; ){
-    cc = read(0, &c, 1);
-    if(cc < 1)
-      break;
+  if(max < 1)
+    return -1;
+  b = empty = 0;
+  n = 0;
+  for(i = 0; i < NRLBUF; i++){
+    if(rlbuf[i].pos < rlbuf[i].n){
+      if(rlbuf[i].fd == fd)
+        b = &rlbuf[i];
+    } else if(empty == 0)
+      empty = &rlbuf[i];
+  }
+  if(b == 0)
+    b = empty;
+
+  for(i = 0; i+1 < max; ){
+    if(b == 0){
+      if((n = read(fd, &c, 1)) < 1)
+        break;
+    } else {
+      if(b->pos == b->n){
+        if((n = read(fd, b->buf, sizeof(b->buf))) < 1)
+          break;
+        b->fd = fd;
+        b->pos = 0;
+        b->n = n;
+      }
+      c = b->buf[b->pos++];
+    }
     buf[i++] = c;
-    if(c == '\n' || c == '\r')
+    if(c == '\n')
       break;
   }
   buf[i] = '\0';
+  if(i == 0 && n < 0)
+    return -1;
+  return i;
+}
+
+// Drop the bytes readline() has buffered from fd, if any.
+void
+rlclose(int fd)
+{
+  int i;
+
+  for(i = 0; i < NRLBUF; i++)
+    if(rlbuf[i].fd == fd)
+      rlbuf[i].pos = rlbuf[i].n = 0;
+}
+
+char*
+gets(char *buf, int max)
+{
+  readline(0, buf, max);
   return buf;
 }
 
@@ -38,35 +38,22 @@ void print_line(int c_flag, int u_flag) {
 }
 
 void uniq(int fd, int c_flag, int u_flag, int w_flag, int w_num) {
-  int n, i;
-  char *p;
+  int n, same;
 
   memset(prev, 0, MAX_LINE);
-  while ((n = read(fd, buf, MAX_LINE - 1)) > 0) {
-    buf[n] = '\0';
-    p = buf;
-    for (i = 0; i < n; i++) {
-      if (buf[i] == '\n' || i == n - 1) {
-        buf[i] = '\0';
-        if (w_flag) {
-          if (mystrncmp(prev, p, w_num) == 0) {
-            count++;
-          } else {
-            print_line(c_flag, u_flag);
-            mystrncpy(prev, p, MAX_LINE);
-            count = 1;
-          }
-        } else {
-          if (strcmp(prev, p) == 0) {
-            count++;
-          } else {
-            print_line(c_flag, u_flag);
-            mystrncpy(prev, p, MAX_LINE);
-            count = 1;
-          }
-        }
-        p = &buf[i + 1];
-      }
+  while ((n = readline(fd, buf, MAX_LINE)) > 0) {
+    if (buf[n - 1] == '\n')
+      buf[n - 1] = '\0';
+    if (w_flag)
+      same = mystrncmp(prev, buf, w_num) == 0;
+    else
+      same = strcmp(prev, buf) == 0;
+    if (same) {
+      count++;
+    } else {
+      print_line(c_flag, u_flag);
+      mystrncpy(prev, buf, MAX_LINE);
+      count = 1;
     }
   }
   print_line(c_flag, u_flag);
@@ -111,6 +98,7 @@ int main(int argc, char *argv[]) {
   }
 
   uniq(fd, c_flag, u_flag, w_flag, w_num);
+  rlclose(fd);
   close(fd);
   exit();
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 struct stat;
+struct dirrec;
 struct rtcdate;
 
 // system calls
@@ -25,6 +26,7 @@ int sleep(int);
 int uptime(void);
 int hello(void);
 int ticks_running(int);
+int getdents(int, struct dirrec*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -34,6 +36,8 @@ char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 void printf(int, const char*, ...);
 char* gets(char*, int max);
+int readline(int, char*, int);
+void rlclose(int);
 uint strlen(const char*);
 void* memset(void*, int, uint);
 void* malloc(uint);